@@ -20,12 +20,23 @@
  * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
  * Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <ndn/hashtb.h>
+#include <ndn/random.h>
+
+#include "ndn_hashtb.h"
+#include "ndn_pool.h"
 
 struct node;
 struct node {
@@ -38,47 +49,1119 @@ struct node {
 #define DATA(ht, p) ((void *)((p) + 1))
 #define KEY(ht, p) ((unsigned char *)((p) + 1) + ht->item_size)
 
-#define CHECKHTE(ht, hte) ((uintptr_t)((hte)->priv[1]) == ~(uintptr_t)(ht))
-#define MARKHTE(ht, hte) ((hte)->priv[1] = (void*)~(uintptr_t)(ht))
+#define CHECKHTE(ht, hte) ((uintptr_t)((hte)->priv[1]) == ~(uintptr_t)(ht))
+#define MARKHTE(ht, hte) ((hte)->priv[1] = (void*)~(uintptr_t)(ht))
+
+/**
+ * Slot arrays of the open addressing engine
+ */
+struct oa_table {
+    unsigned char *ctrl;        /* control byte for each slot */
+    struct node **slot;         /* the nodes, parallel to ctrl */
+    unsigned mask;              /* number of slots - 1 */
+    unsigned n_used;            /* slots that are full or deleted */
+};
+
+struct hashtb {
+    struct node **bucket;       /* hash桶 */
+    size_t item_size;           /* Size of client's per-entry data */
+    unsigned n_buckets;         /* 位置桶的容量 */
+    int n;                      /* 入口数量 Number of entries */
+    int refcount;               /* 活跃的迭代器数量 Number of open enumerators */
+    struct node *deferred;      /* 延后的清理工作 deferred cleanup */
+    struct hashtb_param param;  /* 保存的客户端参数 saved client parameters */
+    size_t (*hash)(const unsigned char *, size_t); /* hash function */
+    struct ndn_pool *pool;      /* where small nodes come from, or NULL */
+    int incremental;            /* migrate to a new size a little at a time */
+    struct node **old_bucket;   /* buckets still being migrated from */
+    unsigned old_n_buckets;
+    unsigned migrate_next;      /* first old bucket or slot not yet moved */
+    struct oa_table oa;         /* open addressing; oa.ctrl is NULL if chained */
+    struct oa_table oa_old;     /* slots still being migrated from */
+    unsigned migrate_left;      /* full slots of oa_old not yet moved */
+    unsigned char *snap;        /* mapped snapshot, or NULL */
+    size_t snap_size;
+    struct oa_table snap_oa;    /* its control bytes; snap_oa.slot unused */
+    const uint64_t *snap_slot;  /* its slots, as offsets into snap */
+};
+
+/*
+ * Incremental rehashing
+ *
+ * Normally a table is resized all at once, and only while no enumerator
+ * other than the one doing the hashtb_seek is open.  With
+ * HASHTB_INCREMENTAL_REHASH the new bucket (or slot) array is allocated
+ * and the old one is kept beside it; each hashtb_seek then moves a few
+ * old buckets over, and lookups consult whichever array holds the
+ * entry.  Starting a migration only redirects where new entries go, so
+ * it may happen while other enumerators are open; entries are moved only
+ * while none are.  Entries not yet moved count toward the load of the
+ * new slots, so that moving them can never fill those slots up.
+ */
+#define MIGRATE_BUCKETS 4
+#define MIGRATE_SLOTS 16
+
+/**
+ * Largest node, including client data and key, that a table created
+ * with HASHTB_POOLED takes from its pool rather than from malloc.
+ */
+#define HASHTB_POOL_MAX_NODE 512
+
+#define NODE_SIZE(ht, keysize, extsize) \
+    (sizeof(struct node) + (ht)->item_size + (keysize) + (extsize))
+
+static struct node *
+node_alloc(struct hashtb *ht, size_t keysize, size_t extsize)
+{
+    if (ht->pool != NULL)
+        return(ndn_pool_alloc(ht->pool, NODE_SIZE(ht, keysize, extsize)));
+    return(calloc(1, NODE_SIZE(ht, keysize, extsize)));
+}
+
+static void
+node_free(struct hashtb *ht, struct node *p)
+{
+    if (ht->pool != NULL)
+        ndn_pool_free(ht->pool, p, NODE_SIZE(ht, p->keysize, p->extsize));
+    else
+        free(p);
+}
+
+// 对key和keysize做哈西
+size_t
+hashtb_hash(const unsigned char *key, size_t key_size)
+{
+    size_t h;
+    size_t i;
+    for (h = key_size + 23, i = 0; i < key_size; i++)
+        h = ((h << 6) ^ (h >> 27)) + key[i];
+    return(h);
+}
+
+/* * * seeded hash * * */
+
+/*
+ * hashtb_hash_seeded reads the key 8 bytes at a time and folds it with
+ * 64x64->128 bit multiplies, in the manner of wyhash.  The seed is drawn
+ * once per process, so the values (and hence which names collide) can't
+ * be predicted by whoever chooses the keys.  The values are not stable
+ * across runs, so they must not be stored or sent anywhere.
+ */
+static const uint64_t hashtb_secret[4] = {
+    UINT64_C(0xa0761d6478bd642f), UINT64_C(0xe7037ed1a0b428db),
+    UINT64_C(0x8ebc6af09c88c6e3), UINT64_C(0x589965cc75374cc3)
+};
+static uint64_t hashtb_seed;
+static pthread_once_t hashtb_seed_once = PTHREAD_ONCE_INIT;
+
+static uint64_t
+hashtb_mix(uint64_t a, uint64_t b)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 r = (unsigned __int128)a * b;
+    return((uint64_t)r ^ (uint64_t)(r >> 64));
+#else
+    uint64_t ha = a >> 32, la = (uint32_t)a;
+    uint64_t hb = b >> 32, lb = (uint32_t)b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32);
+    uint64_t c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    return(lo ^ (rh + (rm0 >> 32) + (rm1 >> 32) + c));
+#endif
+}
+
+static uint64_t
+hashtb_r8(const unsigned char *p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return(v);
+}
+
+static uint64_t
+hashtb_r4(const unsigned char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return(v);
+}
+
+static void
+hashtb_init_seed(void)
+{
+    unsigned char b[sizeof(hashtb_seed)];
+    ndn_random_bytes(b, sizeof(b));
+    memcpy(&hashtb_seed, b, sizeof(b));
+    hashtb_seed ^= hashtb_mix(hashtb_seed ^ hashtb_secret[0], hashtb_secret[1]);
+}
+
+/**
+ * The per-process seed, drawn on first use.
+ *
+ * Handles in different threads may hash for the first time at once, and
+ * each must see the same seed, or a table filled under one would miss
+ * lookups under another.
+ */
+static uint64_t
+hashtb_get_seed(void)
+{
+    pthread_once(&hashtb_seed_once, &hashtb_init_seed);
+    return(hashtb_seed);
+}
+
+/**
+ * Seeded word-at-a-time hash, used by tables created with
+ * HASHTB_SEEDED_HASH.
+ */
+size_t
+hashtb_hash_seeded(const unsigned char *key, size_t key_size)
+{
+    const unsigned char *p = key;
+    const uint64_t *s = hashtb_secret;
+    uint64_t seed;
+    uint64_t a;
+    uint64_t b;
+    size_t i;
+
+    seed = hashtb_get_seed();
+    if (key_size <= 16) {
+        if (key_size >= 4) {
+            i = (key_size >> 3) << 2;
+            a = (hashtb_r4(p) << 32) | hashtb_r4(p + i);
+            b = (hashtb_r4(p + key_size - 4) << 32) | hashtb_r4(p + key_size - 4 - i);
+        }
+        else if (key_size > 0) {
+            a = ((uint64_t)p[0] << 16) | ((uint64_t)p[key_size >> 1] << 8) | p[key_size - 1];
+            b = 0;
+        }
+        else
+            a = b = 0;
+    }
+    else {
+        i = key_size;
+        if (i > 48) {
+            uint64_t see1 = seed;
+            uint64_t see2 = seed;
+            do {
+                seed = hashtb_mix(hashtb_r8(p) ^ s[1], hashtb_r8(p + 8) ^ seed);
+                see1 = hashtb_mix(hashtb_r8(p + 16) ^ s[2], hashtb_r8(p + 24) ^ see1);
+                see2 = hashtb_mix(hashtb_r8(p + 32) ^ s[3], hashtb_r8(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16) {
+            seed = hashtb_mix(hashtb_r8(p) ^ s[1], hashtb_r8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = hashtb_r8(p + i - 16);
+        b = hashtb_r8(p + i - 8);
+    }
+    return((size_t)hashtb_mix(s[1] ^ key_size, hashtb_mix(a ^ s[1], b ^ seed)));
+}
+
+/* end of seeded hash */
+
+/* * * prefix hash * * */
+
+/*
+ * hashtb_hash_prefix folds the key in 8-byte words counted from its
+ * start, carrying any partial word along, and the result depends only on
+ * that state and the length.  So one pass over a name gives the hash of
+ * each of its prefixes on the way; see hashtb_hash_prefixes.  Like
+ * hashtb_hash_seeded, it is seeded per process.
+ */
+struct prefix_state {
+    uint64_t acc;
+    size_t len;
+    unsigned char tail[8];      /* bytes past the last full word */
+};
+
+static void
+prefix_start(struct prefix_state *ps)
+{
+    ps->acc = hashtb_get_seed();
+    ps->len = 0;
+}
+
+static void
+prefix_update(struct prefix_state *ps, const unsigned char *p, size_t n)
+{
+    const uint64_t *s = hashtb_secret;
+    unsigned t = ps->len & 7;
+
+    ps->len += n;
+    if (t != 0) {
+        for (; t < 8 && n > 0; t++, n--)
+            ps->tail[t] = *p++;
+        if (t < 8)
+            return;
+        ps->acc = hashtb_mix(hashtb_r8(ps->tail) ^ s[1], ps->acc ^ s[0]);
+    }
+    for (; n >= 8; p += 8, n -= 8)
+        ps->acc = hashtb_mix(hashtb_r8(p) ^ s[1], ps->acc ^ s[0]);
+    memcpy(ps->tail, p, n);
+}
+
+static size_t
+prefix_final(const struct prefix_state *ps)
+{
+    const uint64_t *s = hashtb_secret;
+    unsigned char b[8] = {0};
+
+    memcpy(b, ps->tail, ps->len & 7);
+    return((size_t)hashtb_mix(ps->acc ^ hashtb_r8(b) ^ s[2], ps->len ^ s[3]));
+}
+
+/**
+ * Hash function of tables created with HASHTB_PREFIX_HASH
+ */
+size_t
+hashtb_hash_prefix(const unsigned char *key, size_t key_size)
+{
+    struct prefix_state ps;
+    prefix_start(&ps);
+    prefix_update(&ps, key, key_size);
+    return(prefix_final(&ps));
+}
+
+/**
+ * Compute the hashtb_hash_prefix values of a series of prefixes
+ *
+ * @param buf holds the bytes to be hashed.
+ * @param ends are offsets into buf, in increasing order; prefix i runs
+ *        from buf + ends[0] to buf + ends[i].  For the components of
+ *        a name, pass comps->buf from ndn_name_split or the like.
+ * @param n is the number of ends.
+ * @param hashes gets the n results, hashes[0] being that of the
+ *        empty key.
+ */
+void
+hashtb_hash_prefixes(const unsigned char *buf, const size_t *ends, int n,
+                     size_t *hashes)
+{
+    struct prefix_state ps;
+    int i;
+
+    prefix_start(&ps);
+    for (i = 0; i < n; i++) {
+        if (i > 0)
+            prefix_update(&ps, buf + ends[i - 1], ends[i] - ends[i - 1]);
+        hashes[i] = prefix_final(&ps);
+    }
+}
+
+/* end of prefix hash */
+
+/* * * open addressing engine * * */
+
+/*
+ * The open addressing engine keeps a power-of-two array of control
+ * bytes, probed linearly, with a parallel array of node pointers.
+ * A control byte is OA_EMPTY, OA_DELETED, or holds 7 bits of the hash
+ * (the fingerprint) for a full slot, so that most mismatches are
+ * settled without touching the node.  The nodes themselves are the
+ * same as for chaining, so data and key pointers stay put for the life
+ * of the entry, as clients expect.
+ *
+ * Deletion leaves a tombstone, so an enumeration is not disturbed by
+ * deleting the current entry.  The slots are rebuilt when too few are
+ * empty, normally only while no other enumerator is open; if one is,
+ * the rebuild waits until there is just one empty slot left.  An
+ * enumerator that finds its node moved finds it again by its hash,
+ * but entries may then be visited twice or missed.
+ *
+ * Enumerators number the slots of oa first and then those of oa_old.
+ */
+#define OA_EMPTY 0x80
+#define OA_DELETED 0xFE
+#define OA_FULL(c) ((c) < 0x80)
+#define OA_MIN_SLOTS 8
+#define OA_SIZE(t) ((t)->mask + 1)
+
+/**
+ * Where probing starts for hash value h, and the fingerprint to look for.
+ */
+static unsigned
+oa_start(const struct oa_table *t, size_t h, unsigned char *fp)
+{
+    uint64_t m = (uint64_t)h * UINT64_C(0x9E3779B97F4A7C15);
+    *fp = (m >> 25) & 0x7F;
+    return((unsigned)(m >> 32) & t->mask);
+}
+
+/**
+ * @returns the slot holding the key, or -1.
+ */
+static int
+oa_find(const struct hashtb *ht, const struct oa_table *t, size_t h,
+        const void *key, size_t keysize)
+{
+    struct node *p;
+    unsigned char fp;
+    unsigned i;
+
+    if (t->ctrl == NULL)
+        return(-1);
+    for (i = oa_start(t, h, &fp); t->ctrl[i] != OA_EMPTY; i = (i + 1) & t->mask) {
+        if (t->ctrl[i] != fp)
+            continue;
+        p = t->slot[i];
+        if (p->hash == h && keysize == p->keysize &&
+            0 == memcmp(key, KEY(ht, p), keysize))
+            return(i);
+    }
+    return(-1);
+}
+
+/**
+ * @returns the slot holding the node, or -1.
+ */
+static int
+oa_find_node(const struct oa_table *t, const struct node *p)
+{
+    unsigned char fp;
+    unsigned i;
+
+    if (t->ctrl == NULL)
+        return(-1);
+    for (i = oa_start(t, p->hash, &fp); t->ctrl[i] != OA_EMPTY; i = (i + 1) & t->mask)
+        if (t->ctrl[i] == fp && t->slot[i] == p)
+            return(i);
+    return(-1);
+}
+
+/**
+ * Put a node that is known to be absent into the first free slot.
+ * @returns the slot.
+ */
+static unsigned
+oa_place(struct oa_table *t, struct node *p)
+{
+    unsigned char fp;
+    unsigned i;
+
+    for (i = oa_start(t, p->hash, &fp); OA_FULL(t->ctrl[i]); i = (i + 1) & t->mask)
+        continue;
+    if (t->ctrl[i] == OA_EMPTY)
+        t->n_used += 1;
+    t->ctrl[i] = fp;
+    t->slot[i] = p;
+    return(i);
+}
+
+static void
+oa_remove(struct oa_table *t, unsigned i)
+{
+    /* no probe needs to pass a slot that is followed by an empty one */
+    if (t->ctrl[(i + 1) & t->mask] == OA_EMPTY) {
+        t->ctrl[i] = OA_EMPTY;
+        t->n_used -= 1;
+    }
+    else
+        t->ctrl[i] = OA_DELETED;
+    t->slot[i] = NULL;
+}
+
+/**
+ * Allocate empty slots, at least n_slots and enough to hold n entries
+ * at a load of 7/8 or below.
+ */
+static int
+oa_alloc(struct oa_table *t, unsigned n_slots, unsigned n)
+{
+    unsigned size = OA_MIN_SLOTS;
+
+    while (size < n_slots || size - size / 8 <= n)
+        size *= 2;
+    t->ctrl = malloc(size);
+    t->slot = calloc(size, sizeof(t->slot[0]));
+    if (t->ctrl == NULL || t->slot == NULL) {
+        free(t->ctrl);
+        free(t->slot);
+        memset(t, 0, sizeof(*t));
+        return(-1);
+    }
+    memset(t->ctrl, OA_EMPTY, size);
+    t->mask = size - 1;
+    t->n_used = 0;
+    return(0);
+}
+
+static void
+oa_free(struct oa_table *t)
+{
+    free(t->ctrl);
+    free(t->slot);
+    memset(t, 0, sizeof(*t));
+}
+
+/**
+ * Reallocate the slots, with room for at least n_slots, and put all the
+ * live nodes back without tombstones, finishing any migration.
+ * @returns 0, or -1 if out of memory (the table is unchanged).
+ */
+static int
+oa_rebuild(struct hashtb *ht, unsigned n_slots)
+{
+    struct oa_table t;
+    struct oa_table *from[2];
+    unsigned i;
+    int k;
+
+    if (oa_alloc(&t, n_slots, ht->n) < 0)
+        return(-1);
+    from[0] = &ht->oa;
+    from[1] = &ht->oa_old;
+    for (k = 0; k < 2; k++) {
+        if (from[k]->ctrl == NULL)
+            continue;
+        for (i = 0; i <= from[k]->mask; i++)
+            if (OA_FULL(from[k]->ctrl[i]))
+                oa_place(&t, from[k]->slot[i]);
+        oa_free(from[k]);
+    }
+    ht->oa = t;
+    ht->migrate_next = 0;
+    ht->migrate_left = 0;
+    return(0);
+}
+
+/**
+ * Start moving to n_slots new slots; the old ones are kept for now.
+ */
+static int
+oa_begin_migration(struct hashtb *ht, unsigned n_slots)
+{
+    struct oa_table t;
+
+    if (oa_alloc(&t, n_slots, ht->n) < 0)
+        return(-1);
+    ht->oa_old = ht->oa;
+    ht->oa = t;
+    ht->migrate_next = 0;
+    ht->migrate_left = ht->n;
+    return(0);
+}
+
+/**
+ * Move the entries in the next count old slots.
+ */
+static void
+oa_migrate(struct hashtb *ht, unsigned count)
+{
+    struct oa_table *old = &ht->oa_old;
+    unsigned i;
+
+    for (; old->ctrl != NULL && count > 0; count--) {
+        i = ht->migrate_next++;
+        if (OA_FULL(old->ctrl[i])) {
+            oa_place(&ht->oa, old->slot[i]);
+            ht->migrate_left -= 1;
+            /* not OA_EMPTY, which would cut off other probes */
+            old->ctrl[i] = OA_DELETED;
+            old->slot[i] = NULL;
+        }
+        if (ht->migrate_next > old->mask) {
+            oa_free(old);
+            ht->migrate_next = 0;
+        }
+    }
+}
+
+/**
+ * Position the enumerator at the first full slot at or after position i
+ */
+static void oa_setpos(struct hashtb_enumerator *hte, unsigned i);
+
+/**
+ * Find the position of the enumerator's current node, even if it has
+ * moved since the enumerator got there.
+ * @returns the position, or -1 if the enumerator is at the end.
+ */
+static int
+oa_where(struct hashtb_enumerator *hte)
+{
+    struct hashtb *ht = hte->ht;
+    struct node *p = hte->priv[2];
+    unsigned i = (uintptr_t)hte->priv[0];
+    unsigned size = OA_SIZE(&ht->oa);
+    unsigned end = size + (ht->oa_old.ctrl == NULL ? 0 : OA_SIZE(&ht->oa_old));
+    int j;
+
+    if (p == NULL)
+        return(-1);
+    if (i < size && ht->oa.slot[i] == p && OA_FULL(ht->oa.ctrl[i]))
+        return(i);
+    if (i >= size && i < end && ht->oa_old.slot[i - size] == p &&
+        OA_FULL(ht->oa_old.ctrl[i - size]))
+        return(i);
+    j = oa_find_node(&ht->oa, p);
+    if (j >= 0)
+        return(j);
+    j = oa_find_node(&ht->oa_old, p);
+    if (j >= 0)
+        return(size + j);
+    /* our node is gone; carry on from about where we were */
+    return(i < end ? i : end - 1);
+}
+
+static void
+oa_setpos(struct hashtb_enumerator *hte, unsigned i)
+{
+    struct hashtb *ht = hte->ht;
+    struct oa_table *t = &ht->oa;
+    unsigned base = 0;
+    struct node *p = NULL;
+
+    for (;;) {
+        for (; i - base <= t->mask; i++) {
+            if (OA_FULL(t->ctrl[i - base])) {
+                p = t->slot[i - base];
+                break;
+            }
+        }
+        if (p != NULL || t == &ht->oa_old || ht->oa_old.ctrl == NULL)
+            break;
+        base = OA_SIZE(t);
+        t = &ht->oa_old;
+    }
+    hte->priv[0] = (void *)(uintptr_t)i;
+    hte->priv[2] = p;
+    if (p == NULL) {
+        hte->key = NULL;
+        hte->keysize = 0;
+        hte->extsize = 0;
+        hte->data = NULL;
+    }
+    else {
+        hte->key = KEY(ht, p);
+        hte->keysize = p->keysize;
+        hte->extsize = p->extsize;
+        hte->data = DATA(ht, p);
+    }
+}
+
+static void
+oa_next(struct hashtb_enumerator *hte)
+{
+    int i = oa_where(hte);
+    if (i < 0)
+        oa_setpos(hte, UINT_MAX - 1);
+    else
+        oa_setpos(hte, i + 1);
+}
+
+static int
+oa_seek(struct hashtb_enumerator *hte, const void *key, size_t keysize, size_t extsize)
+{
+    struct hashtb *ht = hte->ht;
+    struct node *p;
+    size_t h;
+    int i;
+    unsigned n_slots = OA_SIZE(&ht->oa);
+    unsigned want;
+    int res = 0;
+
+    /* count the entries still to be moved, as they will need slots too */
+    if ((ht->oa.n_used + ht->migrate_left + 1) * 8 > n_slots * 7) {
+        /* grow, unless getting rid of tombstones is enough */
+        want = ((unsigned)ht->n + 1) * 16 > n_slots * 7 ? 2 * n_slots : n_slots;
+        if (ht->incremental && ht->oa_old.ctrl == NULL)
+            res = oa_begin_migration(ht, want);
+        else if (ht->refcount == 1 || ht->oa.n_used + 2 > n_slots)
+            res = oa_rebuild(ht, want);
+        if (res < 0 && ht->oa.n_used + 2 > n_slots) {
+            oa_setpos(hte, UINT_MAX - 1);
+            return(-1);
+        }
+    }
+    if (ht->oa_old.ctrl != NULL && ht->refcount == 1)
+        oa_migrate(ht, MIGRATE_SLOTS);
+    h = (*ht->hash)(key, keysize);
+    i = oa_find(ht, &ht->oa, h, key, keysize);
+    if (i >= 0) {
+        oa_setpos(hte, i);
+        return(HT_OLD_ENTRY);
+    }
+    i = oa_find(ht, &ht->oa_old, h, key, keysize);
+    if (i >= 0) {
+        oa_setpos(hte, OA_SIZE(&ht->oa) + i);
+        return(HT_OLD_ENTRY);
+    }
+    p = node_alloc(ht, keysize, extsize);
+    if (p == NULL) {
+        oa_setpos(hte, UINT_MAX - 1);
+        return(-1);
+    }
+    memcpy(KEY(ht, p), key, keysize + extsize);
+    p->hash = h;
+    p->keysize = keysize;
+    p->extsize = extsize;
+    i = oa_place(&ht->oa, p);
+    ht->n += 1;
+    oa_setpos(hte, i);
+    return(HT_NEW_ENTRY);
+}
+
+static void
+oa_delete(struct hashtb_enumerator *hte)
+{
+    struct hashtb *ht = hte->ht;
+    struct oa_table *t = &ht->oa;
+    struct node *p;
+    int i = oa_where(hte);
+    unsigned j;
+
+    if (i < 0 || !CHECKHTE(ht, hte))
+        return;
+    j = i;
+    if (j > t->mask) {
+        j -= OA_SIZE(t);
+        t = &ht->oa_old;
+    }
+    p = t->slot[j];
+    if (p == NULL || p != hte->priv[2] || KEY(ht, p) != hte->key)
+        return;
+    oa_remove(t, j);
+    if (t == &ht->oa_old)
+        ht->migrate_left -= 1;
+    ht->n -= 1;
+    if (ht->refcount == 1) {
+        hashtb_finalize_proc f = ht->param.finalize;
+        if (f != NULL)
+            (*f)(hte);
+        node_free(ht, p);
+    }
+    else {
+        p->link = ht->deferred;
+        ht->deferred = p;
+    }
+    oa_setpos(hte, i + 1);
+}
+
+/* end of open addressing engine */
+
+/* * * chaining engine * * */
+
+/**
+ * The chain that holds, or would hold, hash value h
+ */
+static struct node **
+chain_head(struct hashtb *ht, size_t h)
+{
+    unsigned b;
+    if (ht->old_bucket != NULL) {
+        b = h % ht->old_n_buckets;
+        if (b >= ht->migrate_next)
+            return(&(ht->old_bucket[b]));
+    }
+    return(&(ht->bucket[h % ht->n_buckets]));
+}
+
+/**
+ * Enumeration order of the chain for hash value h; the old buckets
+ * come after the new.
+ */
+static unsigned
+chain_index(struct hashtb *ht, size_t h)
+{
+    unsigned b;
+    if (ht->old_bucket != NULL) {
+        b = h % ht->old_n_buckets;
+        if (b >= ht->migrate_next)
+            return(ht->n_buckets + b);
+    }
+    return(h % ht->n_buckets);
+}
+
+/**
+ * Link p into its sorted place in the chain at pp
+ */
+static void
+chain_insert(struct node **pp, struct node *p)
+{
+    size_t h = p->hash;
+    for (; *pp != NULL && ((*pp)->hash < h); pp = &((*pp)->link))
+        continue;
+    p->link = *pp;
+    *pp = p;
+}
+
+static void
+chain_begin_migration(struct hashtb *ht, unsigned n_buckets)
+{
+    struct node **bucket = calloc(n_buckets, sizeof(bucket[0]));
+    if (bucket == NULL)
+        return; /* ENOMEM */
+    ht->old_bucket = ht->bucket;
+    ht->old_n_buckets = ht->n_buckets;
+    ht->migrate_next = 0;
+    ht->bucket = bucket;
+    ht->n_buckets = n_buckets;
+}
+
+/**
+ * Move the entries in the next count old buckets.
+ */
+static void
+chain_migrate(struct hashtb *ht, unsigned count)
+{
+    struct node *p;
+    struct node *q;
+
+    for (; ht->old_bucket != NULL && count > 0; count--) {
+        for (p = ht->old_bucket[ht->migrate_next]; p != NULL; p = q) {
+            q = p->link;
+            chain_insert(&(ht->bucket[p->hash % ht->n_buckets]), p);
+        }
+        ht->old_bucket[ht->migrate_next++] = NULL;
+        if (ht->migrate_next == ht->old_n_buckets) {
+            free(ht->old_bucket);
+            ht->old_bucket = NULL;
+            ht->old_n_buckets = 0;
+            ht->migrate_next = 0;
+        }
+    }
+}
+
+/* end of chaining engine */
+
+/* * * snapshots * * */
+
+/*
+ * A snapshot is a table written out as one position-independent image:
+ * a header, then the control bytes and slots of an open addressing
+ * table, then the entries.  Each slot holds the offset of its entry,
+ * which is laid out as a struct node (with a zero link) followed by the
+ * client data, key and extension, just as in memory.  Slots are chosen
+ * with hashtb_hash, since it gives the same values in every process.
+ *
+ * hashtb_snapshot_open maps the image and uses it where it lies.  The
+ * image is in the byte order and word size of the writer; a reader that
+ * differs refuses it rather than converting.
+ */
+#define SNAP_MAGIC "NDNHTB1"
+#define SNAP_ORDER 0x01020304
+#define SNAP_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+struct snap_header {
+    char magic[8];
+    uint32_t order;             /* SNAP_ORDER, as the writer stores it */
+    uint32_t node_size;         /* sizeof(struct node) for the writer */
+    uint64_t item_size;
+    uint64_t n;
+    uint64_t n_slots;           /* a power of 2 */
+    uint64_t size;              /* of the whole image */
+};
+
+#define SNAP_NODE(ht, i) ((struct node *)((ht)->snap + (ht)->snap_slot[i]))
+
+static void setnode(struct hashtb_enumerator *hte, struct node *p);
+
+/**
+ * @returns the slot holding the key, or -1.
+ */
+static int
+snap_find(const struct hashtb *ht, size_t h, const void *key, size_t keysize)
+{
+    const struct oa_table *t = &ht->snap_oa;
+    struct node *p;
+    unsigned char fp;
+    unsigned i;
+
+    for (i = oa_start(t, h, &fp); t->ctrl[i] != OA_EMPTY; i = (i + 1) & t->mask) {
+        if (t->ctrl[i] != fp)
+            continue;
+        p = SNAP_NODE(ht, i);
+        if (p->hash == h && keysize == p->keysize &&
+            0 == memcmp(key, KEY(ht, p), keysize))
+            return(i);
+    }
+    return(-1);
+}
+
+/**
+ * Position the enumerator at the first full slot at or after slot i
+ */
+static void
+snap_setpos(struct hashtb_enumerator *hte, unsigned i)
+{
+    struct hashtb *ht = hte->ht;
+    const struct oa_table *t = &ht->snap_oa;
+
+    for (; i <= t->mask; i++)
+        if (OA_FULL(t->ctrl[i]))
+            break;
+    hte->priv[0] = (void *)(uintptr_t)i;
+    setnode(hte, i <= t->mask ? SNAP_NODE(ht, i) : NULL);
+}
+
+static int
+snap_seek(struct hashtb_enumerator *hte, const void *key, size_t keysize)
+{
+    struct hashtb *ht = hte->ht;
+    int i = snap_find(ht, hashtb_hash(key, keysize), key, keysize);
 
-struct hashtb {
-    struct node **bucket;       /* hash桶 */
-    size_t item_size;           /* Size of client's per-entry data */
-    unsigned n_buckets;         /* 位置桶的容量 */
-    int n;                      /* 入口数量 Number of entries */
-    int refcount;               /* 活跃的迭代器数量 Number of open enumerators */
-    struct node *deferred;      /* 延后的清理工作 deferred cleanup */
-    struct hashtb_param param;  /* 保存的客户端参数 saved client parameters */
-};
+    if (i < 0) {
+        snap_setpos(hte, ht->snap_oa.mask + 1);
+        errno = EROFS;
+        return(-1);
+    }
+    snap_setpos(hte, i);
+    return(HT_OLD_ENTRY);
+}
 
-// 对key和keysize做哈西
-size_t
-hashtb_hash(const unsigned char *key, size_t key_size)
+/**
+ * Write the entries of a table to path as a snapshot.
+ *
+ * The client data is copied as it stands, so it should not hold
+ * pointers.  The table must not be changed by anyone else meanwhile.
+ * @returns 0, or -1 for error (with errno set).
+ */
+int
+hashtb_snapshot_write(struct hashtb *ht, const char *path)
 {
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct snap_header *hdr;
+    struct oa_table t = {0};
+    unsigned char *image;
+    uint64_t *slot;
+    struct node *p;
+    size_t n_slots = OA_MIN_SLOTS;
+    size_t size;
+    size_t off;
     size_t h;
+    unsigned char fp;
+    unsigned i;
+    ssize_t res;
+    int fd;
+
+    while (n_slots - n_slots / 8 <= (size_t)ht->n)
+        n_slots *= 2;
+    size = sizeof(*hdr) + n_slots + n_slots * sizeof(slot[0]);
+    for (hashtb_start(ht, e); e->key != NULL; hashtb_next(e))
+        size += SNAP_ALIGN(sizeof(*p) + ht->item_size + e->keysize + e->extsize);
+    hashtb_end(e);
+    image = calloc(1, size);
+    if (image == NULL)
+        return(-1);
+    hdr = (struct snap_header *)image;
+    memcpy(hdr->magic, SNAP_MAGIC, sizeof(hdr->magic));
+    hdr->order = SNAP_ORDER;
+    hdr->node_size = sizeof(*p);
+    hdr->item_size = ht->item_size;
+    hdr->n = ht->n;
+    hdr->n_slots = n_slots;
+    hdr->size = size;
+    t.ctrl = image + sizeof(*hdr);
+    t.mask = n_slots - 1;
+    memset(t.ctrl, OA_EMPTY, n_slots);
+    slot = (uint64_t *)(t.ctrl + n_slots);
+    off = sizeof(*hdr) + n_slots + n_slots * sizeof(slot[0]);
+    for (hashtb_start(ht, e); e->key != NULL; hashtb_next(e)) {
+        h = hashtb_hash(e->key, e->keysize);
+        for (i = oa_start(&t, h, &fp); t.ctrl[i] != OA_EMPTY; i = (i + 1) & t.mask)
+            continue;
+        t.ctrl[i] = fp;
+        slot[i] = off;
+        p = (struct node *)(image + off);
+        p->hash = h;
+        p->keysize = e->keysize;
+        p->extsize = e->extsize;
+        memcpy(DATA(ht, p), e->data, ht->item_size);
+        memcpy(KEY(ht, p), e->key, e->keysize + e->extsize);
+        off += SNAP_ALIGN(sizeof(*p) + ht->item_size + e->keysize + e->extsize);
+    }
+    hashtb_end(e);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        free(image);
+        return(-1);
+    }
+    for (off = 0; off < size; off += res) {
+        res = write(fd, image + off, size - off);
+        if (res == -1 && errno == EINTR)
+            res = 0;
+        else if (res == -1)
+            break;
+    }
+    free(image);
+    if (close(fd) == -1 || off < size)
+        return(-1);
+    return(0);
+}
+
+/**
+ * Check that every slot of a mapped image leads to an entry that lies
+ * within it, and that the control bytes agree with the header.
+ *
+ * Since the count of full slots is then below n_slots and no slot is
+ * marked deleted, every probe sequence ends at an empty slot.
+ * @returns 0 if the image may be used, or -1.
+ */
+static int
+snap_check(const struct snap_header *hdr, const unsigned char *image)
+{
+    const unsigned char *ctrl = image + sizeof(*hdr);
+    const uint64_t *slot = (const uint64_t *)(ctrl + hdr->n_slots);
+    const struct node *p;
+    uint64_t base = sizeof(*hdr) + hdr->n_slots * 9;
+    uint64_t n = 0;
+    uint64_t off;
+    uint64_t room;
     size_t i;
-    for (h = key_size + 23, i = 0; i < key_size; i++)
-        h = ((h << 6) ^ (h >> 27)) + key[i];
-    return(h);
+
+    if (hdr->item_size > hdr->size)
+        return(-1);
+    for (i = 0; i < hdr->n_slots; i++) {
+        if (ctrl[i] == OA_EMPTY)
+            continue;
+        if (!OA_FULL(ctrl[i]))
+            return(-1);
+        n++;
+        off = slot[i];
+        if (off < base || off > hdr->size || (off & 7) != 0 ||
+            hdr->size - off < sizeof(*p))
+            return(-1);
+        p = (const struct node *)(image + off);
+        room = hdr->size - off - sizeof(*p);
+        if (hdr->item_size > room)
+            return(-1);
+        room -= hdr->item_size;
+        if (p->keysize > room || p->extsize > room - p->keysize)
+            return(-1);
+    }
+    return(n == hdr->n ? 0 : -1);
+}
+
+/**
+ * Open a snapshot written by hashtb_snapshot_write.
+ *
+ * The file is mapped and used in place.  Each entry's extent is checked
+ * against the file on the way in, so a truncated or damaged snapshot is
+ * refused rather than read past its end.
+ * The resulting table answers hashtb_lookup and may be enumerated;
+ * hashtb_seek finds the entries that are present, but fails with EROFS
+ * rather than adding one, and hashtb_delete does nothing.  The client
+ * data must not be modified.  Free with hashtb_destroy.
+ * @returns the table, or NULL for error (with errno set).
+ */
+struct hashtb *
+hashtb_snapshot_open(const char *path)
+{
+    struct hashtb *ht;
+    struct snap_header hdr;
+    struct stat st;
+    unsigned char *image;
+    size_t n_slots;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return(NULL);
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(hdr) ||
+        pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr)) {
+        close(fd);
+        errno = EINVAL;
+        return(NULL);
+    }
+    n_slots = hdr.n_slots;
+    if (memcmp(hdr.magic, SNAP_MAGIC, sizeof(hdr.magic)) != 0 ||
+        hdr.order != SNAP_ORDER || hdr.node_size != sizeof(struct node) ||
+        hdr.size != (uint64_t)st.st_size || n_slots < OA_MIN_SLOTS ||
+        (n_slots & (n_slots - 1)) != 0 || hdr.n >= n_slots ||
+        n_slots > UINT_MAX || sizeof(hdr) + n_slots * 9 > hdr.size) {
+        close(fd);
+        errno = EINVAL;
+        return(NULL);
+    }
+    image = mmap(NULL, hdr.size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED)
+        return(NULL);
+    if (snap_check(&hdr, image) != 0) {
+        munmap(image, hdr.size);
+        errno = EINVAL;
+        return(NULL);
+    }
+    ht = calloc(1, sizeof(*ht));
+    if (ht == NULL) {
+        munmap(image, hdr.size);
+        return(NULL);
+    }
+    ht->item_size = hdr.item_size;
+    ht->n = hdr.n;
+    ht->hash = &hashtb_hash;
+    ht->snap = image;
+    ht->snap_size = hdr.size;
+    ht->snap_oa.ctrl = image + sizeof(hdr);
+    ht->snap_oa.mask = n_slots - 1;
+    ht->snap_oa.n_used = hdr.n;
+    ht->snap_slot = (const uint64_t *)(image + sizeof(hdr) + n_slots);
+    return(ht);
 }
 
+/* end of snapshots */
+
 // 创建hashtb时根据指定的size。所以可以自定义table的类型。
 struct hashtb *
 hashtb_create(size_t item_size, const struct hashtb_param *param)
+{
+    return(hashtb_create_flags(item_size, param, 0));
+}
+
+/**
+ * Create a table, choosing its engine and hash with flags.
+ *
+ * @param flags is a combination of the HASHTB_* flags in ndn_hashtb.h;
+ *        0 gives a table just like hashtb_create.
+ * @returns the table, or NULL for error.
+ */
+struct hashtb *
+hashtb_create_flags(size_t item_size, const struct hashtb_param *param,
+                    unsigned flags)
 {
     struct hashtb *ht;
     ht = calloc(1, sizeof(*ht));
     if (ht != NULL) {
         ht->item_size = item_size;
         ht->n = 0;
+        if (param != NULL)
+            ht->param = *param;
+        ht->hash = &hashtb_hash;
+        if ((flags & HASHTB_SEEDED_HASH) != 0)
+            ht->hash = &hashtb_hash_seeded;
+        if ((flags & HASHTB_PREFIX_HASH) != 0)
+            ht->hash = &hashtb_hash_prefix;
+        ht->incremental = (flags & HASHTB_INCREMENTAL_REHASH) != 0;
+        if ((flags & HASHTB_POOLED) != 0) {
+            ht->pool = ndn_pool_create(HASHTB_POOL_MAX_NODE);
+            if (ht->pool == NULL) {
+                free(ht);
+                return(NULL); /*ENOMEM*/
+            }
+        }
+        if ((flags & HASHTB_OPEN_ADDRESSING) != 0) {
+            if (oa_alloc(&ht->oa, ht->param.orig_size, 0) < 0) {
+                ndn_pool_destroy(&ht->pool);
+                free(ht);
+                return(NULL); /*ENOMEM*/
+            }
+            return(ht);
+        }
         ht->n_buckets = 7;
         ht->bucket = calloc(ht->n_buckets, sizeof(ht->bucket[0]));
 	if (ht->bucket == NULL) {
+		ndn_pool_destroy(&ht->pool);
 		free(ht);
 		return (NULL); /*ENOMEM*/
 	}
-        if (param != NULL)
-            ht->param = *param;
     }
     return(ht);
 }
@@ -94,6 +1177,13 @@ hashtb_get_param(struct hashtb *ht, struct hashtb_param *param)
 void
 hashtb_destroy(struct hashtb **htp)
 {
+    if (*htp != NULL && (*htp)->snap != NULL) {
+        if ((*htp)->refcount != 0)
+            abort();
+        munmap((*htp)->snap, (*htp)->snap_size);
+        free(*htp);
+        *htp = NULL;
+    }
     if (*htp != NULL) {
         struct hashtb_enumerator tmp;
         struct hashtb_enumerator *e = hashtb_start(*htp, &tmp);
@@ -102,6 +1192,10 @@ hashtb_destroy(struct hashtb **htp)
         hashtb_end(&tmp);
         if ((*htp)->refcount == 0) {
             free((*htp)->bucket);
+            free((*htp)->old_bucket);
+            ndn_pool_destroy(&(*htp)->pool);
+            oa_free(&(*htp)->oa);
+            oa_free(&(*htp)->oa_old);
             free(*htp);
             *htp = NULL;
         }
@@ -124,13 +1218,40 @@ hashtb_n(struct hashtb *ht)
 void *
 hashtb_lookup(struct hashtb *ht, const void *key, size_t keysize)
 {
-    struct node *p;
-    size_t h;
     if (key == NULL)
         return(NULL);
     // 对key和keysize做哈希
-    h = hashtb_hash(key, keysize);
-    for (p = ht->bucket[h % ht->n_buckets]; p != NULL; p = p->link) {
+    return(hashtb_lookup_hashed(ht, key, keysize, (*ht->hash)(key, keysize)));
+}
+
+/**
+ * Like hashtb_lookup, for a caller that has already hashed the key
+ *
+ * @param h must be the key's hash as the table computes it, such as
+ *        from hashtb_hash_prefixes for a table made with
+ *        HASHTB_PREFIX_HASH.
+ */
+void *
+hashtb_lookup_hashed(struct hashtb *ht, const void *key, size_t keysize, size_t h)
+{
+    struct node *p;
+    int i;
+    if (key == NULL)
+        return(NULL);
+    if (ht->snap != NULL) {
+        i = snap_find(ht, h, key, keysize);
+        return(i >= 0 ? DATA(ht, SNAP_NODE(ht, i)) : NULL);
+    }
+    if (ht->oa.ctrl != NULL) {
+        i = oa_find(ht, &ht->oa, h, key, keysize);
+        if (i >= 0)
+            return(DATA(ht, ht->oa.slot[i]));
+        i = oa_find(ht, &ht->oa_old, h, key, keysize);
+        if (i >= 0)
+            return(DATA(ht, ht->oa_old.slot[i]));
+        return(NULL);
+    }
+    for (p = *chain_head(ht, h); p != NULL; p = p->link) {
         if (p->hash < h)
             continue;
         if (p->hash > h)
@@ -144,13 +1265,9 @@ hashtb_lookup(struct hashtb *ht, const void *key, size_t keysize)
 }
 
 static void
-setpos(struct hashtb_enumerator *hte, struct node **pp)
+setnode(struct hashtb_enumerator *hte, struct node *p)
 {
     struct hashtb *ht = hte->ht;
-    struct node *p = NULL;
-    hte->priv[0] = pp;
-    if (pp != NULL)
-        p = *pp;
     if (p == NULL) {
         hte->key = NULL;
         hte->keysize = 0;
@@ -165,6 +1282,13 @@ setpos(struct hashtb_enumerator *hte, struct node **pp)
     }
 }
 
+static void
+setpos(struct hashtb_enumerator *hte, struct node **pp)
+{
+    hte->priv[0] = pp;
+    setnode(hte, pp != NULL ? *pp : NULL);
+}
+
 // 第b个节点的node结构体
 static struct node **
 scan_buckets(struct hashtb *ht, unsigned b)
@@ -172,6 +1296,11 @@ scan_buckets(struct hashtb *ht, unsigned b)
     for (; b < ht->n_buckets; b++)
         if (ht->bucket[b] != NULL)
             return &(ht->bucket[b]);
+    if (ht->old_bucket != NULL) {
+        for (b -= ht->n_buckets; b < ht->old_n_buckets; b++)
+            if (ht->old_bucket[b] != NULL)
+                return &(ht->old_bucket[b]);
+    }
     return(NULL);
 }
 
@@ -187,7 +1316,12 @@ hashtb_start(struct hashtb *ht, struct hashtb_enumerator *hte)
     if (ht->refcount > MAX_ENUMERATORS)
         abort(); /* probably somebody is missing a call to hashtb_end() */
     // 把迭代器位置设为开头
-    setpos(hte, scan_buckets(ht, 0));
+    if (ht->snap != NULL)
+        snap_setpos(hte, 0);
+    else if (ht->oa.ctrl != NULL)
+        oa_setpos(hte, 0);
+    else
+        setpos(hte, scan_buckets(ht, 0));
     return(hte);
 }
 
@@ -202,16 +1336,17 @@ hashtb_end(struct hashtb_enumerator *hte)
         /* do deferred deallocation */
         f = ht->param.finalize;
         while (ht->deferred != NULL) {
-            setpos(hte, &(ht->deferred));
+            setnode(hte, ht->deferred);
             if (f != NULL)
                 (*f)(hte);
             p = ht->deferred;
             ht->deferred = p->link;
-            free(p);
+            node_free(ht, p);
         }
     }
     hte->priv[0] = 0;
     hte->priv[1] = 0;
+    hte->priv[2] = 0;
     ht->refcount--;
 }
 
@@ -220,11 +1355,19 @@ hashtb_next(struct hashtb_enumerator *hte)
 {
     struct node **pp = hte->priv[0];
     struct node **ppp;
+    if (hte->ht->snap != NULL) {
+        snap_setpos(hte, (uintptr_t)hte->priv[0] + 1);
+        return;
+    }
+    if (hte->ht->oa.ctrl != NULL) {
+        oa_next(hte);
+        return;
+    }
     if (pp != NULL) {
         ppp = pp;
         pp = &((*pp)->link);
         if (*pp == NULL)
-           pp = scan_buckets(hte->ht, ((*ppp)->hash % hte->ht->n_buckets) + 1);
+           pp = scan_buckets(hte->ht, chain_index(hte->ht, (*ppp)->hash) + 1);
     }
     setpos(hte, pp);
 }
@@ -241,13 +1384,23 @@ hashtb_seek(struct hashtb_enumerator *hte, const void *key, size_t keysize, size
         setpos(hte, NULL);
         return(-1);
     }
-    if (ht->refcount == 1 && ht->n > ht->n_buckets * 3) {
-        ht->refcount--;
-        hashtb_rehash(ht, 2 * ht->n + 1);
-        ht->refcount++;
+    if (ht->snap != NULL)
+        return(snap_seek(hte, key, keysize));
+    if (ht->oa.ctrl != NULL)
+        return(oa_seek(hte, key, keysize, extsize));
+    if (ht->old_bucket == NULL && ht->n > ht->n_buckets * 3) {
+        if (ht->incremental)
+            chain_begin_migration(ht, 2 * ht->n + 1);
+        else if (ht->refcount == 1) {
+            ht->refcount--;
+            hashtb_rehash(ht, 2 * ht->n + 1);
+            ht->refcount++;
+        }
     }
-    h = hashtb_hash(key, keysize);
-    pp = &(ht->bucket[h % ht->n_buckets]);
+    if (ht->old_bucket != NULL && ht->refcount == 1)
+        chain_migrate(ht, MIGRATE_BUCKETS);
+    h = (*ht->hash)(key, keysize);
+    pp = chain_head(ht, h);
     for (p = *pp; p != NULL; pp = &(p->link), p = p->link) {
         if (p->hash < h)
             continue;
@@ -258,7 +1411,7 @@ hashtb_seek(struct hashtb_enumerator *hte, const void *key, size_t keysize, size
             return(HT_OLD_ENTRY);
         }
     }
-    p = calloc(1, sizeof(*p) + ht->item_size + keysize + extsize);
+    p = node_alloc(ht, keysize, extsize);
     if (p == NULL) {
         setpos(hte, NULL);
         return(-1);
@@ -279,17 +1432,26 @@ hashtb_delete(struct hashtb_enumerator *hte)
 {
     struct hashtb *ht = hte->ht;
     struct node **pp = hte->priv[0];
-    struct node *p = *pp;
+    struct node *p;
+    if (ht->snap != NULL)
+        return;
+    if (ht->oa.ctrl != NULL) {
+        oa_delete(hte);
+        return;
+    }
+    if (pp == NULL)
+        return;
+    p = *pp;
     if ((p != NULL) && CHECKHTE(ht, hte) && KEY(ht, p) == hte->key) {
         *pp = p->link;
         if (*pp == NULL)
-           pp = scan_buckets(hte->ht, (p->hash % hte->ht->n_buckets) + 1);
+           pp = scan_buckets(hte->ht, chain_index(hte->ht, p->hash) + 1);
         hte->ht->n -= 1;
         if (ht->refcount == 1) {
             hashtb_finalize_proc f = ht->param.finalize;
             if (f != NULL)
                 (*f)(hte);
-            free(p);
+            node_free(ht, p);
         }
         else {
             p->link = ht->deferred;
@@ -303,28 +1465,372 @@ void
 hashtb_rehash(struct hashtb *ht, unsigned n_buckets)
 {
     struct node **bucket = NULL;
-    struct node **pp;
     struct node *p;
     struct node *q;
-    size_t h;
     unsigned i;
-    unsigned b;
-    if (ht->refcount != 0 || n_buckets < 1 || n_buckets == ht->n_buckets)
+    if (ht->snap != NULL)
+        return;
+    if (ht->oa.ctrl != NULL) {
+        if (ht->refcount == 0)
+            oa_rebuild(ht, n_buckets);
+        return;
+    }
+    if (ht->refcount != 0 || n_buckets < 1)
+        return;
+    chain_migrate(ht, UINT_MAX);
+    if (n_buckets == ht->n_buckets)
         return;
     bucket = calloc(n_buckets, sizeof(bucket[0]));
     if (bucket == NULL) return; /* ENOMEM */
     for (i = 0; i < ht->n_buckets; i++) {
         for (p = ht->bucket[i]; p != NULL; p = q) {
             q = p->link;
-            h = p->hash;
-            b = h % n_buckets;
-            for (pp = &bucket[b]; *pp != NULL && ((*pp)->hash < h); pp = &((*pp)->link))
-                continue;
-            p->link = *pp;
-            *pp = p;
+            chain_insert(&bucket[p->hash % n_buckets], p);
         }
     }
     free(ht->bucket);
     ht->bucket = bucket;
     ht->n_buckets = n_buckets;
 }
+
+/**
+ * Make room for n entries in all, so that no insertion up to that many
+ * needs to resize the table.  Any migration in progress is finished.
+ * No enumerators may be open.
+ * @returns 0, or -1 for error.
+ */
+int
+hashtb_reserve(struct hashtb *ht, int n)
+{
+    unsigned more;
+    if (ht->snap != NULL || ht->refcount != 0 || n < 0)
+        return(-1);
+    more = n > ht->n ? n - ht->n : 0;
+    if (ht->oa.ctrl != NULL) {
+        if (ht->oa_old.ctrl == NULL &&
+            (ht->oa.n_used + more) * 8 <= OA_SIZE(&ht->oa) * 7)
+            return(0);
+        return(oa_rebuild(ht, ((unsigned)n * 8 + 6) / 7));
+    }
+    hashtb_rehash(ht, (unsigned)n > ht->n_buckets * 3 ? 2 * n + 1 : ht->n_buckets);
+    if (ht->old_bucket != NULL || (unsigned)n > ht->n_buckets * 3)
+        return(-1);
+    return(0);
+}
+
+/**
+ * Copy into ht the entries of from whose keys it lacks.
+ *
+ * The table is sized once for all of them, so this is the quick way to
+ * fill a table from a snapshot.  The client data is copied as it stands,
+ * and the finalizer of ht will be called for the copies in due course.
+ * @returns the number of entries added, or -1 for error.
+ */
+int
+hashtb_bulk_load(struct hashtb *ht, struct hashtb *from)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct hashtb_enumerator dd;
+    struct hashtb_enumerator *d = &dd;
+    int added = 0;
+    int res;
+
+    if (ht == from || ht->item_size != from->item_size) {
+        errno = EINVAL;
+        return(-1);
+    }
+    if (hashtb_reserve(ht, ht->n + from->n) < 0)
+        return(-1);
+    hashtb_start(ht, d);
+    for (hashtb_start(from, e); e->key != NULL; hashtb_next(e)) {
+        res = hashtb_seek(d, e->key, e->keysize, e->extsize);
+        if (res < 0) {
+            added = -1;
+            break;
+        }
+        if (res == HT_NEW_ENTRY) {
+            memcpy(d->data, e->data, ht->item_size);
+            added++;
+        }
+    }
+    hashtb_end(e);
+    hashtb_end(d);
+    return(added);
+}
+
+/* * * shared tables * * */
+
+/*
+ * A shared table may be read from any number of threads without
+ * locking while writers, one at a time, add to it.  Entries stay until
+ * the table is destroyed, which suits caches of things (such as public
+ * keys) that are costly to get and cheap to keep.
+ *
+ * Readers load the current bucket array and follow its chains.  Both
+ * are published with release stores only when complete, so a reader
+ * sees either the old state or the new, never a partial entry.  Growing
+ * the table builds a new array, with new chain cells for every entry,
+ * and publishes it in one store.  Readers may still be using the old
+ * array, so it is retired rather than freed; since the array doubles
+ * each time, the retired ones together are no bigger than the current.
+ */
+struct shared_cell {
+    struct shared_cell *next;
+    struct node *p;
+};
+
+struct shared_buckets {
+    struct shared_buckets *retired; /* older arrays, freed with the table */
+    unsigned n_buckets;
+    struct shared_cell *bucket[1];  /* actually n_buckets */
+};
+
+struct hashtb_shared {
+    struct shared_buckets *b;   /* current bucket array */
+    size_t item_size;           /* Size of client's per-entry data */
+    int n;                      /* Number of entries */
+    size_t (*hash)(const unsigned char *, size_t); /* hash function */
+    struct hashtb_param param;  /* saved client parameters */
+    pthread_mutex_t lock;       /* held by writers */
+};
+
+#define SHARED_LOAD(pp) __atomic_load_n((pp), __ATOMIC_ACQUIRE)
+#define SHARED_STORE(pp, v) __atomic_store_n((pp), (v), __ATOMIC_RELEASE)
+
+static struct shared_buckets *
+shared_buckets_alloc(unsigned n_buckets)
+{
+    struct shared_buckets *b;
+    b = calloc(1, sizeof(*b) + (n_buckets - 1) * sizeof(b->bucket[0]));
+    if (b != NULL)
+        b->n_buckets = n_buckets;
+    return(b);
+}
+
+static struct node *
+shared_find(struct hashtb_shared *sh, struct shared_buckets *b, size_t h,
+            const void *key, size_t keysize)
+{
+    struct shared_cell *c;
+    struct node *p;
+
+    for (c = SHARED_LOAD(&b->bucket[h % b->n_buckets]); c != NULL;
+         c = SHARED_LOAD(&c->next)) {
+        p = c->p;
+        if (p->hash == h && keysize == p->keysize &&
+            0 == memcmp(key, KEY(sh, p), keysize))
+            return(p);
+    }
+    return(NULL);
+}
+
+/**
+ * Link p into a chain of b, which readers may be following.
+ * @returns 0, or -1 if out of memory.
+ */
+static int
+shared_link(struct shared_buckets *b, struct node *p)
+{
+    struct shared_cell **pp = &b->bucket[p->hash % b->n_buckets];
+    struct shared_cell *c = malloc(sizeof(*c));
+    if (c == NULL)
+        return(-1);
+    c->p = p;
+    c->next = *pp;
+    SHARED_STORE(pp, c);
+    return(0);
+}
+
+/**
+ * Free a bucket array and its cells, but not the entries
+ */
+static void
+shared_buckets_free(struct shared_buckets *b)
+{
+    struct shared_cell *c;
+    struct shared_cell *next;
+    unsigned i;
+
+    for (i = 0; i < b->n_buckets; i++) {
+        for (c = b->bucket[i]; c != NULL; c = next) {
+            next = c->next;
+            free(c);
+        }
+    }
+    free(b);
+}
+
+/**
+ * Replace the bucket array with one of n_buckets, retiring the old one.
+ * The table is unchanged if memory runs out.
+ */
+static void
+shared_grow(struct hashtb_shared *sh, unsigned n_buckets)
+{
+    struct shared_buckets *old = sh->b;
+    struct shared_buckets *b;
+    struct shared_cell *c;
+    unsigned i;
+
+    b = shared_buckets_alloc(n_buckets);
+    if (b == NULL)
+        return; /* ENOMEM */
+    for (i = 0; i < old->n_buckets; i++) {
+        for (c = old->bucket[i]; c != NULL; c = c->next) {
+            if (shared_link(b, c->p) < 0) {
+                shared_buckets_free(b);
+                return; /* ENOMEM */
+            }
+        }
+    }
+    b->retired = old;
+    SHARED_STORE(&sh->b, b);
+}
+
+/**
+ * Create a table that may be shared among threads.
+ *
+ * Of the flags, only HASHTB_SEEDED_HASH applies.  The finalizer is
+ * called for each entry by hashtb_shared_destroy, with an enumerator
+ * whose ht is NULL.
+ * @returns the table, or NULL for error.
+ */
+struct hashtb_shared *
+hashtb_shared_create(size_t item_size, const struct hashtb_param *param,
+                     unsigned flags)
+{
+    struct hashtb_shared *sh;
+
+    sh = calloc(1, sizeof(*sh));
+    if (sh == NULL)
+        return(NULL);
+    sh->item_size = item_size;
+    if (param != NULL)
+        sh->param = *param;
+    sh->hash = &hashtb_hash;
+    if ((flags & HASHTB_SEEDED_HASH) != 0)
+        sh->hash = &hashtb_hash_seeded;
+    sh->b = shared_buckets_alloc(7);
+    if (sh->b == NULL || pthread_mutex_init(&sh->lock, NULL) != 0) {
+        free(sh->b);
+        free(sh);
+        return(NULL); /*ENOMEM*/
+    }
+    return(sh);
+}
+
+/**
+ * Destroy a shared table, which no other thread may be using.
+ */
+void
+hashtb_shared_destroy(struct hashtb_shared **shp)
+{
+    struct hashtb_shared *sh = *shp;
+    struct hashtb_enumerator e = {0};
+    struct shared_buckets *b;
+    struct shared_cell *c;
+    unsigned i;
+
+    if (sh == NULL)
+        return;
+    for (i = 0; i < sh->b->n_buckets; i++) {
+        for (c = sh->b->bucket[i]; c != NULL; c = c->next) {
+            if (sh->param.finalize != NULL) {
+                e.key = KEY(sh, c->p);
+                e.keysize = c->p->keysize;
+                e.extsize = c->p->extsize;
+                e.data = DATA(sh, c->p);
+                e.datasize = sh->item_size;
+                (*sh->param.finalize)(&e);
+            }
+            free(c->p);
+        }
+    }
+    while (sh->b != NULL) {
+        b = sh->b;
+        sh->b = b->retired;
+        shared_buckets_free(b);
+    }
+    pthread_mutex_destroy(&sh->lock);
+    free(sh);
+    *shp = NULL;
+}
+
+/**
+ * Number of entries in a shared table; others may be adding more.
+ */
+int
+hashtb_shared_n(struct hashtb_shared *sh)
+{
+    return(__atomic_load_n(&sh->n, __ATOMIC_RELAXED));
+}
+
+/**
+ * Find an entry of a shared table, without locking.
+ * @returns the client data, or NULL if not present.
+ */
+void *
+hashtb_shared_lookup(struct hashtb_shared *sh, const void *key, size_t keysize)
+{
+    struct node *p;
+    if (key == NULL)
+        return(NULL);
+    p = shared_find(sh, SHARED_LOAD(&sh->b), (*sh->hash)(key, keysize),
+                    key, keysize);
+    return(p != NULL ? DATA(sh, p) : NULL);
+}
+
+/**
+ * Add an entry to a shared table, unless its key is already present.
+ *
+ * The new entry's client data is copied from data, so that it is
+ * complete before any reader can see it.  The key is followed by extsize
+ * bytes of extension, as for hashtb_seek.  If added is not NULL, it is
+ * set to 1 when a new entry was made and to 0 when one already existed.
+ * @returns the client data of the entry with this key, or NULL for error.
+ */
+void *
+hashtb_shared_insert(struct hashtb_shared *sh, const void *key, size_t keysize,
+                     size_t extsize, const void *data, int *added)
+{
+    struct node *p;
+    size_t h;
+
+    if (added != NULL)
+        *added = 0;
+    if (key == NULL)
+        return(NULL);
+    h = (*sh->hash)(key, keysize);
+    pthread_mutex_lock(&sh->lock);
+    p = shared_find(sh, sh->b, h, key, keysize);
+    if (p != NULL) {
+        pthread_mutex_unlock(&sh->lock);
+        return(DATA(sh, p));
+    }
+    if ((unsigned)sh->n >= sh->b->n_buckets * 2)
+        shared_grow(sh, 2 * sh->b->n_buckets + 1);
+    p = calloc(1, NODE_SIZE(sh, keysize, extsize));
+    if (p == NULL) {
+        pthread_mutex_unlock(&sh->lock);
+        return(NULL);
+    }
+    p->hash = h;
+    p->keysize = keysize;
+    p->extsize = extsize;
+    if (data != NULL)
+        memcpy(DATA(sh, p), data, sh->item_size);
+    memcpy(KEY(sh, p), key, keysize + extsize);
+    if (shared_link(sh->b, p) < 0) {
+        pthread_mutex_unlock(&sh->lock);
+        free(p);
+        return(NULL);
+    }
+    __atomic_store_n(&sh->n, sh->n + 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&sh->lock);
+    if (added != NULL)
+        *added = 1;
+    return(DATA(sh, p));
+}
+
+/* end of shared tables */
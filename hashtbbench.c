@@ -0,0 +1,329 @@
+/**
+ * @file hashtbbench.c
+ * @brief Compare the hashtb hash functions on ndnb-encoded names, and
+ *        check the table engines under the way the client uses them.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+#include <ndn/hashtb.h>
+#include <ndn/indexbuf.h>
+
+#include "ndn_hashtb.h"
+
+/*
+ * The keys are the kinds of names the client tables see: short
+ * registered prefixes (interest_filters), and full content names with
+ * version and segment components (the pending interest table).
+ * All the keys of a set are kept end to end in one charbuf.
+ */
+struct keyset {
+    const char *what;
+    struct ndn_charbuf *keys;
+    size_t *off;                /* n + 1 offsets into keys */
+    int n;
+};
+
+static const char *sites[] = {
+    "ucla", "arizona", "memphis", "uiuc", "washu", "colostate", "caida",
+    "parc", "remap", "neu", "tongji", "bupt", "lip6", "wustl"
+};
+#define N_SITES (sizeof(sites) / sizeof(sites[0]))
+
+static const char *apps[] = {
+    "video", "chat", "repo", "ndnfs", "lighting", "sync", "keys", "files"
+};
+#define N_APPS (sizeof(apps) / sizeof(apps[0]))
+
+static double
+now_us(void)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return(tv.tv_sec * 1e6 + tv.tv_usec);
+}
+
+/**
+ * Make n names; if full, with user, file, version, and segment.
+ */
+static void
+keyset_init(struct keyset *ks, const char *what, int n, int full)
+{
+    struct ndn_charbuf *name = ndn_charbuf_create();
+    char buf[64];
+    int i;
+
+    ks->what = what;
+    ks->keys = ndn_charbuf_create();
+    ks->off = calloc(n + 1, sizeof(ks->off[0]));
+    ks->n = n;
+    for (i = 0; i < n; i++) {
+        ndn_name_init(name);
+        ndn_name_append_str(name, "ndn");
+        ndn_name_append_str(name, i % 3 ? "edu" : "org");
+        ndn_name_append_str(name, sites[random() % N_SITES]);
+        if (full) {
+            snprintf(buf, sizeof(buf), "user%ld", random() % 1000);
+            ndn_name_append_str(name, buf);
+            ndn_name_append_str(name, apps[random() % N_APPS]);
+            snprintf(buf, sizeof(buf), "file-%d.dat", i / 50);
+            ndn_name_append_str(name, buf);
+            ndn_name_append_numeric(name, NDN_MARKER_VERSION,
+                                    UINT64_C(1379000000000) + i / 50);
+            ndn_name_append_numeric(name, NDN_MARKER_SEQNUM, i % 50);
+        }
+        else {
+            ndn_name_append_str(name, apps[random() % N_APPS]);
+            snprintf(buf, sizeof(buf), "%d", i);
+            ndn_name_append_str(name, buf);
+        }
+        ks->off[i] = ks->keys->length;
+        ndn_charbuf_append_charbuf(ks->keys, name);
+    }
+    ks->off[n] = ks->keys->length;
+    ndn_charbuf_destroy(&name);
+}
+
+static void
+keyset_destroy(struct keyset *ks)
+{
+    ndn_charbuf_destroy(&ks->keys);
+    free(ks->off);
+}
+
+static void
+bench_hash(struct keyset *ks, const char *label,
+           size_t (*hash)(const unsigned char *, size_t), int rounds)
+{
+    double t0, t1;
+    size_t sum = 0;
+    int r, i;
+
+    t0 = now_us();
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < ks->n; i++)
+            sum += (*hash)(ks->keys->buf + ks->off[i], ks->off[i + 1] - ks->off[i]);
+    t1 = now_us();
+    printf("%-10s %-14s hash           %8.2f ns/key %8.2f ns/byte (%zx)\n",
+           ks->what, label,
+           (t1 - t0) * 1e3 / ((double)rounds * ks->n),
+           (t1 - t0) * 1e3 / ((double)rounds * ks->keys->length),
+           sum & 0xf);
+}
+
+static void
+bench_table(struct keyset *ks, const char *label, unsigned flags, int rounds)
+{
+    struct hashtb_param param = {0};
+    struct hashtb *ht;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    double t0, t1, t2;
+    int found = 0;
+    int r, i;
+
+    ht = hashtb_create_flags(sizeof(int), &param, flags);
+    t0 = now_us();
+    hashtb_start(ht, e);
+    for (i = 0; i < ks->n; i++)
+        hashtb_seek(e, ks->keys->buf + ks->off[i], ks->off[i + 1] - ks->off[i], 0);
+    hashtb_end(e);
+    t1 = now_us();
+    for (r = 0; r < rounds; r++)
+        for (i = 0; i < ks->n; i++)
+            if (hashtb_lookup(ht, ks->keys->buf + ks->off[i], ks->off[i + 1] - ks->off[i]) != NULL)
+                found++;
+    t2 = now_us();
+    printf("%-10s %-14s seek/lookup    %8.2f ns/key %8.2f ns/key (%d)\n",
+           ks->what, label,
+           (t1 - t0) * 1e3 / ks->n,
+           (t2 - t1) * 1e3 / ((double)rounds * ks->n),
+           found / rounds);
+    hashtb_destroy(&ht);
+}
+
+/**
+ * Look up every prefix of every name, as dispatch does, first by
+ * hashing each prefix from the start and then in one pass per name.
+ */
+static void
+bench_prefixes(struct keyset *ks, int rounds)
+{
+    struct hashtb_param param = {0};
+    struct hashtb *ht;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ndn_charbuf *name = ndn_charbuf_create();
+    struct ndn_indexbuf *comps = ndn_indexbuf_create();
+    struct ndn_indexbuf *ends = ndn_indexbuf_create();
+    size_t *first = calloc(ks->n + 1, sizeof(first[0]));
+    size_t hashes[64];
+    const unsigned char *base;
+    double t0, t1, t2;
+    int found = 0;
+    int r, i, j, n;
+
+    ht = hashtb_create_flags(sizeof(int), &param, HASHTB_PREFIX_HASH);
+    hashtb_start(ht, e);
+    for (i = 0; i < ks->n; i++) {
+        name->length = 0;
+        ndn_charbuf_append(name, ks->keys->buf + ks->off[i], ks->off[i + 1] - ks->off[i]);
+        ndn_name_split(name, comps);
+        first[i] = ends->n;
+        for (j = 0; j < (int)comps->n && j < 64; j++) {
+            ndn_indexbuf_append_element(ends, ks->off[i] + comps->buf[j]);
+            hashtb_seek(e, ks->keys->buf + ks->off[i] + comps->buf[0],
+                        comps->buf[j] - comps->buf[0], 0);
+        }
+    }
+    first[ks->n] = ends->n;
+    hashtb_end(e);
+    t0 = now_us();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < ks->n; i++) {
+            base = ks->keys->buf + ends->buf[first[i]];
+            for (j = first[i]; j < first[i + 1]; j++)
+                if (hashtb_lookup(ht, base, ends->buf[j] - ends->buf[first[i]]) != NULL)
+                    found++;
+        }
+    }
+    t1 = now_us();
+    for (r = 0; r < rounds; r++) {
+        for (i = 0; i < ks->n; i++) {
+            base = ks->keys->buf + ends->buf[first[i]];
+            n = first[i + 1] - first[i];
+            hashtb_hash_prefixes(ks->keys->buf, ends->buf + first[i], n, hashes);
+            for (j = 0; j < n; j++)
+                if (hashtb_lookup_hashed(ht, base, ends->buf[first[i] + j] - ends->buf[first[i]],
+                                         hashes[j]) != NULL)
+                    found++;
+        }
+    }
+    t2 = now_us();
+    printf("%-10s %-14s all prefixes   %8.2f ns/name %7.2f ns/name (%d)\n",
+           ks->what, "each/one pass",
+           (t1 - t0) * 1e3 / ((double)rounds * ks->n),
+           (t2 - t1) * 1e3 / ((double)rounds * ks->n),
+           found / (2 * rounds));
+    hashtb_destroy(&ht);
+    ndn_charbuf_destroy(&name);
+    ndn_indexbuf_destroy(&comps);
+    ndn_indexbuf_destroy(&ends);
+    free(first);
+}
+
+/**
+ * Insert in batches while n_held other enumerators are open, as dispatch
+ * does from its upcalls, and after each batch seek with those closed.
+ * Resizing is put off while the other enumerator is open, so this is
+ * when a table can run out of empty slots.
+ * @returns 0, or -1 if an entry went missing.
+ */
+static int
+check_held_enumerator(struct keyset *ks, const char *label, unsigned flags,
+                      int n_held)
+{
+    struct hashtb_param param = {0};
+    struct hashtb *ht;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct hashtb_enumerator held[2];
+    int missing = 0;
+    int i, j, k;
+
+    ht = hashtb_create_flags(sizeof(int), &param, flags);
+    for (i = 0; i < ks->n; i = j) {
+        for (k = 0; k < n_held && k < 2; k++)
+            hashtb_start(ht, &held[k]);
+        for (j = i; j < ks->n && j < i + 20 + i / 4; j++) {
+            hashtb_start(ht, e);
+            hashtb_seek(e, ks->keys->buf + ks->off[j], ks->off[j + 1] - ks->off[j], 0);
+            hashtb_end(e);
+        }
+        while (k > 0)
+            hashtb_end(&held[--k]);
+        hashtb_start(ht, e);
+        if (hashtb_seek(e, "zz", 2, 0) == HT_NEW_ENTRY)
+            hashtb_delete(e);
+        hashtb_end(e);
+    }
+    for (i = 0; i < ks->n; i++)
+        if (hashtb_lookup(ht, ks->keys->buf + ks->off[i], ks->off[i + 1] - ks->off[i]) == NULL)
+            missing++;
+    if (hashtb_n(ht) != ks->n)
+        missing++;
+    printf("%-10s %-14s held enumerator %s\n",
+           ks->what, label, missing == 0 ? "ok" : "FAILED");
+    hashtb_destroy(&ht);
+    return(missing == 0 ? 0 : -1);
+}
+
+int
+main(int argc, char **argv)
+{
+    int n = argc > 1 ? atoi(argv[1]) : 100000;
+    int rounds = 10;
+    struct keyset sets[2];
+    int res = 0;
+    int k;
+
+    if (n < 1) {
+        fprintf(stderr, "usage: %s [ nkeys ]\n", argv[0]);
+        exit(1);
+    }
+    srandom(1);
+    keyset_init(&sets[0], "prefixes", n, 0);
+    keyset_init(&sets[1], "content", n, 1);
+    /* a table that runs out of empty slots probes forever */
+    alarm(60);
+    for (k = 0; k < 2; k++) {
+        res |= check_held_enumerator(&sets[k], "chained+incr",
+                                     HASHTB_INCREMENTAL_REHASH, 1);
+        res |= check_held_enumerator(&sets[k], "open",
+                                     HASHTB_OPEN_ADDRESSING, 1);
+        res |= check_held_enumerator(&sets[k], "open+incr",
+                                     HASHTB_OPEN_ADDRESSING | HASHTB_INCREMENTAL_REHASH, 1);
+        /* the flags of the client's tables, with name_tree and
+           interests_by_prefix both held as in dispatch */
+        res |= check_held_enumerator(&sets[k], "client",
+                                     HASHTB_OPEN_ADDRESSING | HASHTB_INCREMENTAL_REHASH |
+                                     HASHTB_SEEDED_HASH | HASHTB_POOLED, 2);
+    }
+    alarm(0);
+    for (k = 0; k < 2; k++) {
+        printf("%-10s %d keys, mean size %.1f bytes\n", sets[k].what, n,
+               (double)sets[k].keys->length / n);
+        bench_hash(&sets[k], "hashtb_hash", &hashtb_hash, rounds);
+        bench_hash(&sets[k], "seeded", &hashtb_hash_seeded, rounds);
+        bench_table(&sets[k], "chained", 0, rounds);
+        bench_table(&sets[k], "chained+seeded", HASHTB_SEEDED_HASH, rounds);
+        bench_table(&sets[k], "chained+pooled", HASHTB_POOLED, rounds);
+        bench_table(&sets[k], "open", HASHTB_OPEN_ADDRESSING, rounds);
+        bench_table(&sets[k], "open+seeded",
+                    HASHTB_OPEN_ADDRESSING | HASHTB_SEEDED_HASH, rounds);
+        bench_prefixes(&sets[k], rounds);
+    }
+    for (k = 0; k < 2; k++)
+        keyset_destroy(&sets[k]);
+    return(res == 0 ? 0 : 1);
+}
@@ -19,7 +19,102 @@
 #include <ndn/ndn.h>
 #include <ndn/charbuf.h>
 #include <ndn/uri.h>
+#include <ndn/indexbuf.h>
 
+#include "ndn_segfetch.h"
+#include "ndn_stream.h"
+
+/*
+ * Streamed content is handed over before the signature is checked, so
+ * it is held in a temporary file, and copied to stdout only once the
+ * signature is known to be good and ndn_get has returned that object.
+ */
+struct peek_stream {
+  FILE *tmp;                  /* content of the object being streamed */
+  struct ndn_charbuf *good;   /* Signature through SignedInfo of the
+                                 last object that verified */
+  int bad;                    /* an object failed verification */
+};
+
+/**
+ * The part of a ContentObject that identifies it: from its Signature
+ * through its SignedInfo
+ */
+static void
+peek_ident(const unsigned char *msg, const struct ndn_parsed_ContentObject *pco,
+           const unsigned char **ptr, size_t *length)
+{
+  *ptr = msg + pco->offset[NDN_PCO_B_Signature];
+  *length = pco->offset[NDN_PCO_E_SignedInfo] - pco->offset[NDN_PCO_B_Signature];
+}
+
+/**
+ * Hold large content until it has been verified, except for one
+ * segment of a segmented stream, which is fetched as a whole below.
+ */
+static int
+peek_sink(enum ndn_stream_kind kind, const struct ndn_stream_info *info,
+          void *data)
+{
+  struct peek_stream *ps = data;
+  const struct ndn_indexbuf *comps = info->content_comps;
+  const unsigned char *ptr;
+  size_t length;
+
+  switch (kind) {
+  case NDN_STREAM_HEAD:
+    if (comps->n >= 2 &&
+        ndn_name_comp_get(info->content_ndnb, comps, comps->n - 2,
+                          &ptr, &length) == 0 &&
+        length >= 1 && ptr[0] == NDN_MARKER_SEQNUM)
+      return -1;
+    ps->good->length = 0;
+    rewind(ps->tmp);
+    if (ftruncate(fileno(ps->tmp), 0) < 0)
+      return -1;
+    return 0;
+  case NDN_STREAM_DATA:
+    if (fwrite(info->data, 1, info->size, ps->tmp) != info->size)
+      return -1;
+    return 0;
+  case NDN_STREAM_END:
+    if (info->verified != 1) {
+      ps->bad = 1;
+      return 0;
+    }
+    peek_ident(info->content_ndnb, info->pco, &ptr, &length);
+    ndn_charbuf_append(ps->good, ptr, length);
+    return 0;
+  default:
+    ps->good->length = 0;
+    return 0;
+  }
+}
+
+/**
+ * Copy the held content to stdout if msg is the object it came in.
+ * @returns 1 if copied, 0 if msg was not streamed, -1 for error.
+ */
+static int
+peek_emit(struct peek_stream *ps, const unsigned char *msg,
+          const struct ndn_parsed_ContentObject *pco)
+{
+  const unsigned char *ptr;
+  size_t length;
+  char buf[8192];
+  size_t n;
+
+  peek_ident(msg, pco, &ptr, &length);
+  if (ps->good->length == 0 || length != ps->good->length ||
+      memcmp(ptr, ps->good->buf, length) != 0)
+    return 0;
+  fflush(ps->tmp);
+  rewind(ps->tmp);
+  while ((n = fread(buf, 1, sizeof(buf), ps->tmp)) > 0)
+    if (fwrite(buf, 1, n, stdout) != n)
+      return -1;
+  return ferror(ps->tmp) ? -1 : 1;
+}
 
 int main(int argc, char** argv) {
   int res;
@@ -32,6 +127,9 @@ int main(int argc, char** argv) {
   int get_flags = 0;
   const unsigned char *ptr;
   size_t length;
+  struct ndn_indexbuf *comps = NULL;
+  struct ndn_charbuf *prefix = NULL;
+  struct peek_stream ps = { 0 };
 
 
 
@@ -39,8 +137,39 @@ int main(int argc, char** argv) {
   ndn_name_from_uri(name, argv[1]);
   h = ndn_create();
   res = ndn_connect(h, NULL);
+  ps.tmp = tmpfile();
+  ps.good = ndn_charbuf_create();
+  if (ps.tmp != NULL)
+    ndn_set_content_sink(h, 0, peek_sink, &ps);
   resultbuf = ndn_charbuf_create();
-  res = ndn_get(h, name, templ, timeout_ms, resultbuf, &pcobuf, NULL, get_flags);
+  comps = ndn_indexbuf_create();
+  res = ndn_get(h, name, templ, timeout_ms, resultbuf, &pcobuf, comps, get_flags);
+  if (res < 0) {
+    if (ps.bad)
+      fprintf(stderr, "%s: content failed verification; nothing written\n",
+              argv[0]);
+    return 1;
+  }
+  /*
+   * If what came back is one segment of several, pull the whole stream
+   * (from segment 0 of that version) with a window of interests.
+   */
+  if (comps->n >= 2 &&
+      ndn_name_comp_get(resultbuf->buf, comps, comps->n - 2, &ptr, &length) == 0 &&
+      length >= 1 && ptr[0] == NDN_MARKER_SEQNUM &&
+      ndn_is_final_pco(resultbuf->buf, &pcobuf, comps) != 1) {
+    prefix = ndn_charbuf_create();
+    ndn_name_init(prefix);
+    ndn_name_append_components(prefix, resultbuf->buf,
+                               comps->buf[0], comps->buf[comps->n - 2]);
+    fflush(stdout);
+    res = ndn_segfetch_fd(h, prefix, NDN_V_HIGHEST, timeout_ms, get_flags, 1, NULL);
+    return res < 0 ? 1 : 0;
+  }
+  /* Content that was streamed is empty here, and comes from ps.tmp. */
+  res = peek_emit(&ps, resultbuf->buf, &pcobuf);
+  if (res != 0)
+    return res < 0 ? 1 : 0;
   ptr = resultbuf->buf;
   length = resultbuf->length;
   ndn_content_get_value(ptr, length, &pcobuf, &ptr, &length);
@@ -0,0 +1,310 @@
+/**
+ * @file ndn_arena.c
+ * @brief Bump allocation arenas for per-message scratch buffers.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ndn/charbuf.h>
+#include <ndn/indexbuf.h>
+
+#include "ndn_arena.h"
+
+/** Allocations are rounded up to this; it is also the alignment. */
+#define ARENA_GRAIN 16
+#define ARENA_CHUNK_SIZE 8192
+
+#define ARENA_ROUND(size) \
+    (((size) + ARENA_GRAIN - 1) & ~(size_t)(ARENA_GRAIN - 1))
+
+/*
+ * The chunk header is padded to ARENA_GRAIN so that the memory after
+ * it stays aligned.
+ */
+union arena_chunk {
+    struct {
+        union arena_chunk *next;
+        size_t size;            /* bytes after the header */
+    } h;
+    unsigned char pad[ARENA_GRAIN];
+};
+
+struct ndn_arena {
+    struct ndn_arena *outer;    /* next arena entered on this thread */
+    int depth;                  /* nesting of ndn_arena_enter */
+    int borrowed;               /* arena lives in caller space */
+    size_t chunk_size;          /* size of each added chunk */
+    unsigned char *base;        /* first chunk, kept for the arena's life */
+    size_t base_size;
+    unsigned char *avail;       /* unused part of the newest chunk */
+    size_t n_avail;
+    union arena_chunk *chunks;  /* added chunks in use, newest first */
+    union arena_chunk *spare;   /* added chunks kept for the next round */
+};
+
+/** Arenas entered on this thread, innermost first. */
+static __thread struct ndn_arena *arena_entered = NULL;
+
+static void
+arena_reset(struct ndn_arena *a)
+{
+    union arena_chunk *c;
+
+    while (a->chunks != NULL) {
+        c = a->chunks;
+        a->chunks = c->h.next;
+        if (a->borrowed || c->h.size != a->chunk_size)
+            free(c);
+        else {
+            c->h.next = a->spare;
+            a->spare = c;
+        }
+    }
+    a->avail = a->base;
+    a->n_avail = a->base_size;
+}
+
+/**
+ * Create an arena whose first chunk holds chunk_size bytes.
+ *
+ * That chunk is allocated along with the arena and kept until it is
+ * destroyed, as are any further chunks of the same size, so a workload
+ * that fits settles down to no allocation at all.
+ * @returns the new arena, or NULL for error.
+ */
+struct ndn_arena *
+ndn_arena_create(size_t chunk_size)
+{
+    struct ndn_arena *a;
+    size_t hsize = ARENA_ROUND(sizeof(*a));
+
+    if (chunk_size == 0)
+        chunk_size = ARENA_CHUNK_SIZE;
+    chunk_size = ARENA_ROUND(chunk_size);
+    a = calloc(1, hsize + chunk_size);
+    if (a == NULL)
+        return(NULL);
+    a->chunk_size = chunk_size;
+    a->base = (unsigned char *)a + hsize;
+    a->base_size = chunk_size;
+    arena_reset(a);
+    return(a);
+}
+
+/**
+ * Set up an arena in caller-supplied space, typically a local array,
+ * which then doubles as small-buffer storage.
+ *
+ * Anything that does not fit goes to chunks that are freed again when
+ * the arena is left, so such an arena holds no memory between uses and
+ * need not be destroyed.
+ * @returns the arena, or NULL if the space is too small.
+ */
+struct ndn_arena *
+ndn_arena_init(void *space, size_t size)
+{
+    struct ndn_arena *a;
+    uintptr_t start = (uintptr_t)space;
+    uintptr_t end = start + size;
+    size_t hsize = ARENA_ROUND(sizeof(*a));
+
+    start = ARENA_ROUND(start);
+    if (end < start || end - start < hsize + ARENA_GRAIN)
+        return(NULL);
+    a = (struct ndn_arena *)start;
+    memset(a, 0, sizeof(*a));
+    a->borrowed = 1;
+    a->chunk_size = ARENA_CHUNK_SIZE;
+    a->base = (unsigned char *)(start + hsize);
+    a->base_size = (end - start - hsize) & ~(size_t)(ARENA_GRAIN - 1);
+    arena_reset(a);
+    return(a);
+}
+
+/**
+ * Destroy an arena, along with everything allocated from it.
+ */
+void
+ndn_arena_destroy(struct ndn_arena **ap)
+{
+    struct ndn_arena *a = *ap;
+    union arena_chunk *c;
+
+    if (a == NULL)
+        return;
+    if (a->depth > 0) {
+        a->depth = 1;
+        ndn_arena_leave(a);
+    }
+    arena_reset(a);
+    while (a->spare != NULL) {
+        c = a->spare;
+        a->spare = c->h.next;
+        free(c);
+    }
+    if (!a->borrowed)
+        free(a);
+    *ap = NULL;
+}
+
+/**
+ * Enter an arena on the calling thread.
+ *
+ * Buffers carved from the arena are recognized as such only while it
+ * is entered.  Calls may nest; the arena is left when the outermost
+ * ndn_arena_leave() is reached.
+ */
+void
+ndn_arena_enter(struct ndn_arena *a)
+{
+    if (a == NULL)
+        return;
+    if (a->depth++ == 0) {
+        a->outer = arena_entered;
+        arena_entered = a;
+    }
+}
+
+/**
+ * Leave an arena, taking back everything that was allocated from it.
+ */
+void
+ndn_arena_leave(struct ndn_arena *a)
+{
+    struct ndn_arena **pp;
+
+    if (a == NULL || a->depth == 0 || --a->depth > 0)
+        return;
+    for (pp = &arena_entered; *pp != NULL; pp = &(*pp)->outer) {
+        if (*pp == a) {
+            *pp = a->outer;
+            break;
+        }
+    }
+    a->outer = NULL;
+    arena_reset(a);
+}
+
+/**
+ * Find the entered arena, if any, that p was allocated from.
+ *
+ * This is cheap when no arena is entered, which is the common case
+ * for code that is not in the middle of dispatching a message.
+ */
+struct ndn_arena *
+ndn_arena_owner(const void *p)
+{
+    struct ndn_arena *a;
+    union arena_chunk *c;
+    uintptr_t q = (uintptr_t)p;
+
+    for (a = arena_entered; a != NULL; a = a->outer) {
+        if (q - (uintptr_t)a->base < a->base_size)
+            return(a);
+        for (c = a->chunks; c != NULL; c = c->h.next)
+            if (q - (uintptr_t)(c + 1) < c->h.size)
+                return(a);
+    }
+    return(NULL);
+}
+
+/**
+ * Allocate size bytes, uninitialized, from an arena.
+ *
+ * There is no way to free the block; the memory comes back when the
+ * arena is left.
+ * @returns the block, or NULL for error.
+ */
+void *
+ndn_arena_alloc(struct ndn_arena *a, size_t size)
+{
+    union arena_chunk *c;
+    unsigned char *p;
+    size_t n;
+
+    if (size > SIZE_MAX - sizeof(*c) - ARENA_GRAIN)
+        return(NULL);
+    size = ARENA_ROUND(size == 0 ? 1 : size);
+    if (a->n_avail < size) {
+        c = a->spare;
+        if (c != NULL && size <= c->h.size)
+            a->spare = c->h.next;
+        else {
+            n = size > a->chunk_size ? size : a->chunk_size;
+            c = malloc(sizeof(*c) + n);
+            if (c == NULL)
+                return(NULL);
+            c->h.size = n;
+        }
+        c->h.next = a->chunks;
+        a->chunks = c;
+        a->avail = (unsigned char *)(c + 1);
+        a->n_avail = c->h.size;
+    }
+    p = a->avail;
+    a->avail += size;
+    a->n_avail -= size;
+    return(p);
+}
+
+/**
+ * Create an empty charbuf in an entered arena, with room for n bytes
+ * before it needs to grow.
+ * @returns the charbuf, or NULL if the arena is not entered or is
+ *          out of memory.
+ */
+struct ndn_charbuf *
+ndn_arena_charbuf(struct ndn_arena *a, size_t n)
+{
+    struct ndn_charbuf *c;
+    size_t hsize = ARENA_ROUND(sizeof(*c));
+
+    if (a == NULL || a->depth == 0 || n > SIZE_MAX / 2)
+        return(NULL);
+    c = ndn_arena_alloc(a, hsize + n);
+    if (c == NULL)
+        return(NULL);
+    c->length = 0;
+    c->limit = n;
+    c->buf = (n == 0) ? NULL : (unsigned char *)c + hsize;
+    return(c);
+}
+
+/**
+ * Create an empty indexbuf in an entered arena, with room for n values
+ * before it needs to grow.
+ * @returns the indexbuf, or NULL if the arena is not entered or is
+ *          out of memory.
+ */
+struct ndn_indexbuf *
+ndn_arena_indexbuf(struct ndn_arena *a, size_t n)
+{
+    struct ndn_indexbuf *x;
+    size_t hsize = ARENA_ROUND(sizeof(*x));
+
+    if (a == NULL || a->depth == 0 || n > SIZE_MAX / 2 / sizeof(x->buf[0]))
+        return(NULL);
+    x = ndn_arena_alloc(a, hsize + n * sizeof(x->buf[0]));
+    if (x == NULL)
+        return(NULL);
+    x->n = 0;
+    x->limit = n;
+    x->buf = (n == 0) ? NULL : (size_t *)((unsigned char *)x + hsize);
+    return(x);
+}
@@ -0,0 +1,56 @@
+/**
+ * @file ndn_arena.h
+ * @brief Bump allocation arenas for per-message scratch buffers.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_ARENA_DEFINED
+#define NDN_ARENA_DEFINED
+
+#include <stddef.h>
+
+struct ndn_charbuf;
+struct ndn_indexbuf;
+
+/**
+ * An arena hands out memory by bumping a pointer through large chunks
+ * and takes it all back at once when it is left, so that the scratch
+ * buffers of one unit of work (say, the dispatch of one message) cost
+ * no malloc or free in the steady state.
+ *
+ * Charbufs and indexbufs may be carved from an arena that has been
+ * entered on the calling thread.  They start out with inline storage
+ * next to the struct, grow within the arena, and ndn_charbuf_destroy()
+ * and ndn_indexbuf_destroy() leave them alone, so they may be passed
+ * to any code that works on ordinary buffers.  They must not be used
+ * after the arena is left.
+ */
+struct ndn_arena;
+
+struct ndn_arena *ndn_arena_create(size_t chunk_size);
+struct ndn_arena *ndn_arena_init(void *space, size_t size);
+void ndn_arena_destroy(struct ndn_arena **ap);
+
+void ndn_arena_enter(struct ndn_arena *a);
+void ndn_arena_leave(struct ndn_arena *a);
+struct ndn_arena *ndn_arena_owner(const void *p);
+
+void *ndn_arena_alloc(struct ndn_arena *a, size_t size);
+struct ndn_charbuf *ndn_arena_charbuf(struct ndn_arena *a, size_t n);
+struct ndn_indexbuf *ndn_arena_indexbuf(struct ndn_arena *a, size_t n);
+
+#endif
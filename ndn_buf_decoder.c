@@ -27,6 +27,8 @@
 #include <ndn/coding.h>
 #include <ndn/indexbuf.h>
 
+#include "ndn_coding.h"
+
 struct ndn_buf_decoder *
 ndn_buf_decoder_start(struct ndn_buf_decoder *d,
                       const unsigned char *buf, size_t size)
@@ -64,6 +66,38 @@ ndn_buf_match_some_dtag(struct ndn_buf_decoder *d)
            NDN_GET_TT_FROM_DSTATE(d->decoder.state) == NDN_DTAG);
 }
 
+/**
+ * Sniff the type of an ndnb-encoded message from its outermost tag,
+ * reading only the first token header and without starting a decoder.
+ *
+ * This is just a hint for choosing a parser; the message is not
+ * checked past its first few bytes.
+ * @returns the dtag of the outermost element (e.g. NDN_DTAG_Interest,
+ *          NDN_DTAG_ContentObject, NDN_DTAG_StatusResponse), or -1 if
+ *          the message does not start with a DTAG.
+ */
+int
+ndn_message_dtag(const unsigned char *msg, size_t size)
+{
+    int numval = 0;
+    size_t i;
+    unsigned char c;
+    if (size > 0 && msg[0] == NDN_CLOSE)
+        return(-1); /* leading zero, or an unbalanced close */
+    /* the dtags in use need far fewer than 4 header bytes */
+    for (i = 0; i < size && i < 4; i++) {
+        c = msg[i];
+        if ((c & NDN_TT_HBIT) == 0) {
+            numval = (numval << 7) + c;
+            continue;
+        }
+        if ((c & NDN_TT_MASK) != NDN_DTAG)
+            return(-1);
+        return((numval << (7-NDN_TT_BITS)) + ((c >> NDN_TT_BITS) & NDN_MAX_TINY));
+    }
+    return(-1);
+}
+
 int
 ndn_buf_match_some_blob(struct ndn_buf_decoder *d)
 {
@@ -863,6 +897,84 @@ ndn_parse_ContentObject(const unsigned char *msg, size_t size,
     return(0);
 }
 
+/**
+ * Magic value of a ndn_parsed_ContentObject that has only its Name
+ * (and offset[NDN_PCO_E]) filled in
+ */
+#define NDN_PCO_LAZY_MAGIC 20131017
+
+/**
+ * Parse only the Name of a ContentObject
+ *
+ * This sets the NDN_PCO_B_Name through NDN_PCO_E_Name offsets,
+ * name_ncomps, the components, and offset[NDN_PCO_E], which is
+ * taken to be size.  That is enough to match the object against
+ * interests.  The Signature is skipped, and SignedInfo and Content are
+ * left alone until ndn_parse_ContentObject_finish is called.  Nothing
+ * past the Name is checked, so a message that might be malformed there
+ * must be finished before it is trusted.
+ * @returns 0, or a negative value for error.
+ */
+int
+ndn_parse_ContentObject_lazy(const unsigned char *msg, size_t size,
+                             struct ndn_parsed_ContentObject *x,
+                             struct ndn_indexbuf *components)
+{
+    struct ndn_buf_decoder decoder;
+    struct ndn_buf_decoder *d = ndn_buf_decoder_start(&decoder, msg, size);
+    int res;
+    memset(x->offset, 0, sizeof(x->offset));
+    x->magic = NDN_PCO_LAZY_MAGIC;
+    x->digest_bytes = 0;
+    if (ndn_buf_match_dtag(d, NDN_DTAG_ContentObject)) {
+        ndn_buf_advance(d);
+        if (ndn_buf_match_dtag(d, NDN_DTAG_Signature))
+            ndn_buf_advance_past_element(d);
+        x->offset[NDN_PCO_B_Name] = d->decoder.token_index;
+        x->offset[NDN_PCO_B_Component0] = d->decoder.index;
+        res = ndn_parse_Name(d, components);
+        if (res < 0)
+            d->decoder.state = -__LINE__;
+        x->name_ncomps = res;
+        x->offset[NDN_PCO_E_ComponentLast] = d->decoder.token_index - 1;
+        x->offset[NDN_PCO_E_Name] = d->decoder.token_index;
+        x->offset[NDN_PCO_E] = size;
+    }
+    else
+        d->decoder.state = -__LINE__;
+    if (d->decoder.state < 0)
+        return (NDN_DSTATE_ERR_CODING);
+    return(0);
+}
+
+/**
+ * Complete the parse of a ContentObject begun with
+ * ndn_parse_ContentObject_lazy
+ *
+ * Does nothing if x is already complete.  A digest already computed
+ * for the object is kept.
+ * @returns 0, or a negative value if the object is malformed.
+ */
+int
+ndn_parse_ContentObject_finish(const unsigned char *msg, size_t size,
+                               struct ndn_parsed_ContentObject *x)
+{
+    unsigned char digest[sizeof(x->digest)];
+    int digest_bytes = x->digest_bytes;
+    int res;
+    if (x->magic != NDN_PCO_LAZY_MAGIC)
+        return(0);
+    memcpy(digest, x->digest, sizeof(digest));
+    res = ndn_parse_ContentObject(msg, size, x, NULL);
+    if (res < 0) {
+        x->magic = NDN_PCO_LAZY_MAGIC; /* still not usable */
+        return(res);
+    }
+    memcpy(x->digest, digest, sizeof(digest));
+    x->digest_bytes = digest_bytes;
+    return(res);
+}
+
 int
 ndn_ref_tagged_BLOB(enum ndn_dtag tt,
                     const unsigned char *buf, size_t start, size_t stop,
@@ -24,7 +24,9 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <sys/time.h>
+#include <sys/uio.h>
 #include <ndn/ndn.h>
 #include <ndn/charbuf.h>
 #include <ndn/coding.h>
@@ -32,6 +34,9 @@
 #include <ndn/signing.h>
 #include <ndn/ndn_private.h>
 
+#include "ndn_coding.h"
+#include "ndn_iov.h"
+
 /**
  * Create SignedInfo.
  *
@@ -63,6 +68,16 @@ ndn_signed_info_create(struct ndn_charbuf *c,
 
     if (publisher_key_id != NULL && publisher_key_id_size != 32)
         return(-1);
+    /*
+     * Reserve once, rather than growing c as we go.  The markers and
+     * closer of each element take at most 4 bytes; then there are the
+     * digest, a timestamp of now, the Type, and the FreshnessSeconds digits.
+     */
+    if (ndn_charbuf_reserve(c, 8 * 4 + 32 + 9 + 3 + 10 +
+                            (timestamp != NULL ? timestamp->length : 0) +
+                            (finalblockid != NULL ? finalblockid->length : 0) +
+                            (key_locator != NULL ? key_locator->length : 0)) == NULL)
+        return(-1);
 
     res |= ndn_charbuf_append_tt(c, NDN_DTAG_SignedInfo, NDN_DTAG);
 
@@ -92,7 +107,7 @@ ndn_signed_info_create(struct ndn_charbuf *c,
     }
 
     if (freshness >= 0)
-        res |= ndnb_tagged_putf(c, NDN_DTAG_FreshnessSeconds, "%d", freshness);
+        res |= ndnb_append_tagged_number(c, NDN_DTAG_FreshnessSeconds, freshness);
 
     if (finalblockid != NULL) {
         res |= ndn_charbuf_append_tt(c, NDN_DTAG_FinalBlockID, NDN_DTAG);
@@ -110,47 +125,176 @@ ndn_signed_info_create(struct ndn_charbuf *c,
     return(res == 0 ? 0 : -1);
 }
 
-static int
-ndn_encode_Signature(struct ndn_charbuf *buf,
-                     const char *digest_algorithm,
-                     const void *witness,
-                     size_t witness_size,
-                     const struct ndn_signature *signature,
-                     size_t signature_size)
+/* size of the ndnb start marker for val */
+static size_t
+ndnb_tt_size(size_t val)
 {
-    int res = 0;
+    size_t n = 1;
+    for (val >>= (7-NDN_TT_BITS); val != 0; val >>= 7)
+        n++;
+    return(n);
+}
 
-    if (signature == NULL)
-        return(-1);
+/* like ndn_charbuf_append_tt, but to p, which must have room */
+static unsigned char *
+ndnb_put_tt(unsigned char *p, size_t val, enum ndn_tt tt)
+{
+    size_t n = ndnb_tt_size(val);
+    size_t i = n - 1;
+    p[i] = (NDN_TT_HBIT & ~NDN_CLOSE) |
+           ((val & NDN_MAX_TINY) << NDN_TT_BITS) |
+           (NDN_TT_MASK & tt);
+    val >>= (7-NDN_TT_BITS);
+    while (i > 0) {
+        p[--i] = (((unsigned char)val) & ~NDN_TT_HBIT) | NDN_CLOSE;
+        val >>= 7;
+    }
+    return(p + n);
+}
 
-    res |= ndn_charbuf_append_tt(buf, NDN_DTAG_Signature, NDN_DTAG);
+static unsigned char *
+ndnb_put(unsigned char *p, const void *data, size_t size)
+{
+    memcpy(p, data, size);
+    return(p + size);
+}
 
-    if (digest_algorithm != NULL) {
-        res |= ndn_charbuf_append_tt(buf, NDN_DTAG_DigestAlgorithm, NDN_DTAG);
-        res |= ndn_charbuf_append_tt(buf, strlen(digest_algorithm), NDN_UDATA);
-        res |= ndn_charbuf_append_string(buf, digest_algorithm);
-        res |= ndn_charbuf_append_closer(buf);
-    }
+/* what follows the payload: </Content></ContentObject> */
+static const unsigned char ndnb_ContentObject_tail[2] = { NDN_CLOSE, NDN_CLOSE };
 
-    if (witness != NULL) {
-        res |= ndn_charbuf_append_tt(buf, NDN_DTAG_Witness, NDN_DTAG);
-        res |= ndn_charbuf_append_tt(buf, witness_size, NDN_BLOB);
-        res |= ndn_charbuf_append(buf, witness, witness_size);
-        res |= ndn_charbuf_append_closer(buf);
+/*
+ * The Content start marker, and the BLOB marker if there is a payload.
+ * buf needs room for two start markers.
+ * @returns the size.
+ */
+static size_t
+ndnb_put_Content_head(unsigned char *buf, size_t size)
+{
+    unsigned char *p = buf;
+    p = ndnb_put_tt(p, NDN_DTAG_Content, NDN_DTAG);
+    if (size != 0)
+        p = ndnb_put_tt(p, size, NDN_BLOB);
+    return(p - buf);
+}
+
+/*
+ * Sign the parts of a ContentObject, with the payload where it is.
+ * @returns the signature, to be freed by the caller, or NULL for error.
+ */
+static struct ndn_signature *
+ndnb_sign_ContentObject(const struct ndn_charbuf *Name,
+                        const struct ndn_charbuf *SignedInfo,
+                        const void *data,
+                        size_t size,
+                        const char *digest_algorithm,
+                        const struct ndn_pkey *private_key,
+                        size_t *signature_size)
+{
+    struct ndn_sigc *sig_ctx;
+    struct ndn_signature *signature = NULL;
+    unsigned char content_head[2 * 12];
+    size_t content_head_size;
+    int res = -1;
+
+    content_head_size = ndnb_put_Content_head(content_head, size);
+    sig_ctx = ndn_sigc_create();
+    if (sig_ctx == NULL)
+        return(NULL);
+    if (0 != ndn_sigc_init(sig_ctx, digest_algorithm, private_key))
+        goto Finish;
+    if (0 != ndn_sigc_update(sig_ctx, Name->buf, Name->length))
+        goto Finish;
+    if (0 != ndn_sigc_update(sig_ctx, SignedInfo->buf, SignedInfo->length))
+        goto Finish;
+    if (0 != ndn_sigc_update(sig_ctx, content_head, content_head_size))
+        goto Finish;
+    if (0 != ndn_sigc_update(sig_ctx, data, size))
+        goto Finish;
+    if (0 != ndn_sigc_update(sig_ctx, ndnb_ContentObject_tail, 1))
+        goto Finish;
+    signature = calloc(1, ndn_sigc_signature_max_size(sig_ctx, private_key));
+    if (signature == NULL)
+        goto Finish;
+    res = ndn_sigc_final(sig_ctx, signature, signature_size, private_key);
+Finish:
+    ndn_sigc_destroy(&sig_ctx);
+    if (res != 0) {
+        free(signature);
+        return(NULL);
     }
+    return(signature);
+}
 
-    res |= ndn_charbuf_append_tt(buf, NDN_DTAG_SignatureBits, NDN_DTAG);
-    res |= ndn_charbuf_append_tt(buf, signature_size, NDN_BLOB);
-    res |= ndn_charbuf_append(buf, signature, signature_size);
-    res |= ndn_charbuf_append_closer(buf);
+/* size of what ndnb_put_ContentObject_head writes */
+static size_t
+ndnb_ContentObject_head_size(const struct ndn_charbuf *Name,
+                             const struct ndn_charbuf *SignedInfo,
+                             size_t size,
+                             const char *digest_algorithm,
+                             size_t signature_size)
+{
+    size_t n = 0;
+    size_t alen;
 
-    res |= ndn_charbuf_append_closer(buf);
+    n += ndnb_tt_size(NDN_DTAG_ContentObject);
+    n += ndnb_tt_size(NDN_DTAG_Signature);
+    if (digest_algorithm != NULL) {
+        alen = strlen(digest_algorithm);
+        n += ndnb_tt_size(NDN_DTAG_DigestAlgorithm);
+        n += ndnb_tt_size(alen) + alen + 1;
+    }
+    n += ndnb_tt_size(NDN_DTAG_SignatureBits);
+    n += ndnb_tt_size(signature_size) + signature_size + 1;
+    n += 1; /* </Signature> */
+    n += Name->length;
+    n += SignedInfo->length;
+    n += ndnb_tt_size(NDN_DTAG_Content);
+    if (size != 0)
+        n += ndnb_tt_size(size);
+    return(n);
+}
 
-    return(res == 0 ? 0 : -1);
+/*
+ * Everything of the ContentObject that comes before the payload:
+ * the start marker, the Signature, Name and SignedInfo, and the start
+ * of the Content.  p must have ndnb_ContentObject_head_size bytes.
+ */
+static unsigned char *
+ndnb_put_ContentObject_head(unsigned char *p,
+                            const struct ndn_charbuf *Name,
+                            const struct ndn_charbuf *SignedInfo,
+                            size_t size,
+                            const char *digest_algorithm,
+                            const struct ndn_signature *signature,
+                            size_t signature_size)
+{
+    size_t alen;
+
+    p = ndnb_put_tt(p, NDN_DTAG_ContentObject, NDN_DTAG);
+    p = ndnb_put_tt(p, NDN_DTAG_Signature, NDN_DTAG);
+    if (digest_algorithm != NULL) {
+        alen = strlen(digest_algorithm);
+        p = ndnb_put_tt(p, NDN_DTAG_DigestAlgorithm, NDN_DTAG);
+        p = ndnb_put_tt(p, alen, NDN_UDATA);
+        p = ndnb_put(p, digest_algorithm, alen);
+        *p++ = NDN_CLOSE;
+    }
+    p = ndnb_put_tt(p, NDN_DTAG_SignatureBits, NDN_DTAG);
+    p = ndnb_put_tt(p, signature_size, NDN_BLOB);
+    p = ndnb_put(p, signature, signature_size);
+    *p++ = NDN_CLOSE; /* </SignatureBits> */
+    *p++ = NDN_CLOSE; /* </Signature> */
+    p = ndnb_put(p, Name->buf, Name->length);
+    p = ndnb_put(p, SignedInfo->buf, SignedInfo->length);
+    p += ndnb_put_Content_head(p, size);
+    return(p);
 }
 
 /**
  * Encode and sign a ContentObject.
+ *
+ * The object is signed first, so that its exact size is known, and
+ * then written with a single reservation of buf.
  * @param buf is the output buffer where encoded object is written.
  * @param Name is the ndnb-encoded name from ndn_name_init and friends.
  * @param SignedInfo is the ndnb-encoded info from ndn_signed_info_create.
@@ -170,56 +314,156 @@ ndn_encode_ContentObject(struct ndn_charbuf *buf,
                          const struct ndn_pkey *private_key
                          )
 {
-    int res = 0;
-    struct ndn_sigc *sig_ctx;
     struct ndn_signature *signature;
     size_t signature_size;
-    struct ndn_charbuf *content_header;
-    size_t closer_start;
+    size_t head_size;
+    unsigned char *p;
 
-    content_header = ndn_charbuf_create();
-    res |= ndn_charbuf_append_tt(content_header, NDN_DTAG_Content, NDN_DTAG);
-    if (size != 0)
-        res |= ndn_charbuf_append_tt(content_header, size, NDN_BLOB);
-    closer_start = content_header->length;
-    res |= ndn_charbuf_append_closer(content_header);
-    if (res < 0)
+    signature = ndnb_sign_ContentObject(Name, SignedInfo, data, size,
+                                        digest_algorithm, private_key,
+                                        &signature_size);
+    if (signature == NULL)
         return(-1);
+    head_size = ndnb_ContentObject_head_size(Name, SignedInfo, size,
+                                             digest_algorithm, signature_size);
+    p = ndn_charbuf_reserve(buf, head_size + size + sizeof(ndnb_ContentObject_tail));
+    if (p == NULL) {
+        free(signature);
+        return(-1);
+    }
+    p = ndnb_put_ContentObject_head(p, Name, SignedInfo, size,
+                                    digest_algorithm, signature, signature_size);
+    p = ndnb_put(p, data, size);
+    p = ndnb_put(p, ndnb_ContentObject_tail, sizeof(ndnb_ContentObject_tail));
+    buf->length = p - buf->buf;
+    free(signature);
+    return(0);
+}
+
+/**
+ * The most room that ndn_encode_ContentObject_buf can need.
+ *
+ * This is exact for keys that always give signatures of the same size,
+ * such as RSA keys.
+ * @returns the size in bytes, or 0 for error.
+ */
+size_t
+ndn_encode_ContentObject_max_size(const struct ndn_charbuf *Name,
+                                  const struct ndn_charbuf *SignedInfo,
+                                  size_t size,
+                                  const char *digest_algorithm,
+                                  const struct ndn_pkey *private_key)
+{
+    struct ndn_sigc *sig_ctx;
+    size_t signature_size = 0;
+
     sig_ctx = ndn_sigc_create();
     if (sig_ctx == NULL)
+        return(0);
+    if (0 == ndn_sigc_init(sig_ctx, digest_algorithm, private_key))
+        signature_size = ndn_sigc_signature_max_size(sig_ctx, private_key);
+    ndn_sigc_destroy(&sig_ctx);
+    if (signature_size == 0)
+        return(0);
+    return(ndnb_ContentObject_head_size(Name, SignedInfo, size,
+                                        digest_algorithm, signature_size) +
+           size + sizeof(ndnb_ContentObject_tail));
+}
+
+/**
+ * Encode and sign a ContentObject into caller memory.
+ *
+ * Like ndn_encode_ContentObject, but for callers that keep their own
+ * buffers, sized with ndn_encode_ContentObject_max_size.
+ * @param out is where the object goes.
+ * @param outsize is the room at out.
+ * @returns the size of the object, or -1 for error, including if it
+ *          does not fit.
+ */
+int
+ndn_encode_ContentObject_buf(unsigned char *out, size_t outsize,
+                             const struct ndn_charbuf *Name,
+                             const struct ndn_charbuf *SignedInfo,
+                             const void *data,
+                             size_t size,
+                             const char *digest_algorithm,
+                             const struct ndn_pkey *private_key)
+{
+    struct ndn_signature *signature;
+    size_t signature_size;
+    size_t total;
+    unsigned char *p;
+
+    signature = ndnb_sign_ContentObject(Name, SignedInfo, data, size,
+                                        digest_algorithm, private_key,
+                                        &signature_size);
+    if (signature == NULL)
         return(-1);
-    if (0 != ndn_sigc_init(sig_ctx, digest_algorithm, private_key))
-        return(-1);
-    if (0 != ndn_sigc_update(sig_ctx, Name->buf, Name->length))
-        return(-1);
-    if (0 != ndn_sigc_update(sig_ctx, SignedInfo->buf, SignedInfo->length))
-        return(-1);
-    if (0 != ndn_sigc_update(sig_ctx, content_header->buf, closer_start))
-        return(-1);
-    if (0 != ndn_sigc_update(sig_ctx, data, size))
-        return(-1);
-    if (0 != ndn_sigc_update(sig_ctx, content_header->buf + closer_start,
-                             content_header->length - closer_start))
+    total = ndnb_ContentObject_head_size(Name, SignedInfo, size,
+                                         digest_algorithm, signature_size) +
+            size + sizeof(ndnb_ContentObject_tail);
+    if (total > outsize || total > INT_MAX) {
+        free(signature);
         return(-1);
-    signature = calloc(1, ndn_sigc_signature_max_size(sig_ctx, private_key));
+    }
+    p = ndnb_put_ContentObject_head(out, Name, SignedInfo, size,
+                                    digest_algorithm, signature, signature_size);
+    p = ndnb_put(p, data, size);
+    p = ndnb_put(p, ndnb_ContentObject_tail, sizeof(ndnb_ContentObject_tail));
+    free(signature);
+    return(total);
+}
+
+/**
+ * Encode and sign a ContentObject as a list of pieces, without copying
+ * the payload.
+ *
+ * The pieces are what comes before the payload, which is appended to
+ * head, then the payload itself, then the closers.  They are ready for
+ * writev or ndn_put_iov, and stay valid for as long as data does and
+ * head is not changed.
+ * @param head is the buffer to append the start of the object to.
+ * @param iov is filled in with NDN_CONTENTOBJECT_IOV pieces.
+ * @returns the number of pieces, or -1 for error.
+ */
+int
+ndn_encode_ContentObject_iov(struct ndn_charbuf *head,
+                             struct iovec *iov,
+                             const struct ndn_charbuf *Name,
+                             const struct ndn_charbuf *SignedInfo,
+                             const void *data,
+                             size_t size,
+                             const char *digest_algorithm,
+                             const struct ndn_pkey *private_key)
+{
+    struct ndn_signature *signature;
+    size_t signature_size;
+    size_t head_size;
+    unsigned char *p;
+
+    signature = ndnb_sign_ContentObject(Name, SignedInfo, data, size,
+                                        digest_algorithm, private_key,
+                                        &signature_size);
     if (signature == NULL)
         return(-1);
-    res = ndn_sigc_final(sig_ctx, signature, &signature_size, private_key);
-    if (0 != res) {
+    head_size = ndnb_ContentObject_head_size(Name, SignedInfo, size,
+                                             digest_algorithm, signature_size);
+    p = ndn_charbuf_reserve(head, head_size);
+    if (p == NULL) {
         free(signature);
         return(-1);
     }
-    ndn_sigc_destroy(&sig_ctx);
-    res |= ndn_charbuf_append_tt(buf, NDN_DTAG_ContentObject, NDN_DTAG);
-    res |= ndn_encode_Signature(buf, digest_algorithm,
-                                NULL, 0, signature, signature_size);
-    res |= ndn_charbuf_append_charbuf(buf, Name);
-    res |= ndn_charbuf_append_charbuf(buf, SignedInfo);
-    res |= ndnb_append_tagged_blob(buf, NDN_DTAG_Content, data, size);
-    res |= ndn_charbuf_append_closer(buf);
+    ndnb_put_ContentObject_head(p, Name, SignedInfo, size,
+                                digest_algorithm, signature, signature_size);
+    head->length += head_size;
     free(signature);
-    ndn_charbuf_destroy(&content_header);
-    return(res == 0 ? 0 : -1);
+    iov[0].iov_base = p;
+    iov[0].iov_len = head_size;
+    iov[1].iov_base = (void *)data;
+    iov[1].iov_len = size;
+    iov[2].iov_base = (void *)ndnb_ContentObject_tail;
+    iov[2].iov_len = sizeof(ndnb_ContentObject_tail);
+    return(NDN_CONTENTOBJECT_IOV);
 }
 
 /***********************************
@@ -239,9 +483,10 @@ ndn_encode_StatusResponse(struct ndn_charbuf *buf,
     if (errcode < 100 || errcode > 999)
         return(-1);
     res |= ndn_charbuf_append_tt(buf, NDN_DTAG_StatusResponse, NDN_DTAG);
-    res |= ndnb_tagged_putf(buf, NDN_DTAG_StatusCode, "%d", errcode);
+    res |= ndnb_append_tagged_number(buf, NDN_DTAG_StatusCode, errcode);
     if (errtext != NULL && errtext[0] != 0)
-        res |= ndnb_tagged_putf(buf, NDN_DTAG_StatusText, "%s", errtext);
+        res |= ndnb_append_tagged_udata(buf, NDN_DTAG_StatusText,
+                                        errtext, strlen(errtext));
     res |= ndn_charbuf_append_closer(buf);
     return(res);
 }
@@ -286,6 +531,41 @@ ndn_charbuf_append_closer(struct ndn_charbuf *c)
     return(res);
 }
 
+/* "00" through "99", so decimals are done two digits at a time */
+static const char ndnb_digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324"
+    "25262728293031323334353637383940414243444546474849"
+    "50515253545556575859606162636465666768697071727374"
+    "75767778798081828384858687888990919293949596979899";
+
+/* room for the decimal digits of any uintmax_t */
+#define NDNB_DECIMAL_MAX (3 * sizeof(uintmax_t))
+
+/**
+ * Format val in decimal, backwards from end.
+ * @returns the number of digits, which end just before end.
+ */
+static int
+ndnb_format_decimal(char *end, uintmax_t val)
+{
+    char *p = end;
+    unsigned d;
+    while (val >= 100) {
+        d = (val % 100) * 2;
+        val /= 100;
+        *--p = ndnb_digit_pairs[d + 1];
+        *--p = ndnb_digit_pairs[d];
+    }
+    if (val >= 10) {
+        d = val * 2;
+        *--p = ndnb_digit_pairs[d + 1];
+        *--p = ndnb_digit_pairs[d];
+    }
+    else
+        *--p = '0' + val;
+    return(end - p);
+}
+
 /**
  * Append a non-negative integer as a UDATA.
  * @param c is the buffer to append to.
@@ -295,17 +575,15 @@ ndn_charbuf_append_closer(struct ndn_charbuf *c)
 int
 ndnb_append_number(struct ndn_charbuf *c, int nni)
 {
-    char nnistring[40];
-    int nnistringlen;
+    char digits[NDNB_DECIMAL_MAX];
+    int n;
     int res;
 
     if (nni < 0)
         return(-1);
-    nnistringlen = snprintf(nnistring, sizeof(nnistring), "%d", nni);
-    if (nnistringlen >= sizeof(nnistring))
-        return(-1);
-    res = ndn_charbuf_append_tt(c, nnistringlen, NDN_UDATA);
-    res |= ndn_charbuf_append_string(c, nnistring);
+    n = ndnb_format_decimal(digits + sizeof(digits), nni);
+    res = ndn_charbuf_append_tt(c, n, NDN_UDATA);
+    res |= ndn_charbuf_append(c, digits + sizeof(digits) - n, n);
     return(res);
 }
 
@@ -441,6 +719,57 @@ ndnb_append_tagged_binary_number(struct ndn_charbuf *cb,
     return(res);
 }
 
+/**
+ * Append a tagged UDATA string
+ *
+ * This is a ndnb-encoded element with containing UDATA as content,
+ * without the formatting of ndnb_tagged_putf.
+ * @param c is the buffer to append to.
+ * @param dtag is the element's dtag
+ * @param data points to the string, which need not be nul-terminated
+ * @param size is the size of the string, in bytes
+ * @returns 0 for success or -1 for error.
+ */
+int
+ndnb_append_tagged_udata(struct ndn_charbuf *c,
+                         enum ndn_dtag dtag,
+                         const void *data,
+                         size_t size)
+{
+    int res;
+
+    res = ndn_charbuf_append_tt(c, dtag, NDN_DTAG);
+    if (size != 0) {
+        res |= ndn_charbuf_append_tt(c, size, NDN_UDATA);
+        res |= ndn_charbuf_append(c, data, size);
+    }
+    res |= ndn_charbuf_append_closer(c);
+    return(res == 0 ? 0 : -1);
+}
+
+/**
+ * Append a tagged non-negative integer, in decimal
+ *
+ * This gives the same encoding as ndnb_tagged_putf with "%d" or "%u",
+ * and is what selectors such as MinSuffixComponents and Scope, and
+ * fields such as FreshnessSeconds, should use.
+ * @param c is the buffer to append to.
+ * @param dtag is the element's dtag
+ * @param val is the value
+ * @returns 0 for success or -1 for error.
+ */
+int
+ndnb_append_tagged_number(struct ndn_charbuf *c,
+                          enum ndn_dtag dtag,
+                          uintmax_t val)
+{
+    char digits[NDNB_DECIMAL_MAX];
+    int n;
+
+    n = ndnb_format_decimal(digits + sizeof(digits), val);
+    return(ndnb_append_tagged_udata(c, dtag, digits + sizeof(digits) - n, n));
+}
+
 /**
  * Append a tagged UDATA string, with printf-style formatting
  * 添加含有标签的UDATA字符串. 参数是printf格式的.
@@ -27,6 +27,8 @@
 #include <sys/time.h>
 #include <ndn/charbuf.h>
 
+#include "ndn_arena.h"
+
 struct ndn_charbuf *
 ndn_charbuf_create(void)
 {
@@ -60,6 +62,11 @@ ndn_charbuf_destroy(struct ndn_charbuf **cbp)
 {
     struct ndn_charbuf *c = *cbp;
     if (c != NULL) {
+        /* arena buffers go back all at once when the arena is left */
+        if (ndn_arena_owner(c) != NULL) {
+            *cbp = NULL;
+            return;
+        }
         if (c->buf != NULL)
             free(c->buf);
         free(c);
@@ -75,22 +82,33 @@ ndn_charbuf_reserve(struct ndn_charbuf *c, size_t n)
 {
     size_t newsz = n + c->length;
     unsigned char *buf = c->buf;
+    struct ndn_arena *a;
     if (newsz < n)
         return(NULL);
     if (newsz > c->limit) {
         if (2 * c->limit > newsz)
             newsz = 2 * c->limit;
+        a = ndn_arena_owner(c);
+        if (a != NULL) {
+            buf = ndn_arena_alloc(a, newsz);
+            if (buf == NULL)
+                return(NULL);
+            if (c->limit != 0)
+                memcpy(buf, c->buf, c->limit);
+        }
+        else {
 #ifdef NDN_NOREALLOC
-        buf = malloc(newsz);
-        if (buf == NULL)
-            return(NULL);
-        memcpy(buf, c->buf, c->limit);
-        free(c->buf);
+            buf = malloc(newsz);
+            if (buf == NULL)
+                return(NULL);
+            memcpy(buf, c->buf, c->limit);
+            free(c->buf);
 #else
-        buf = realloc(c->buf, newsz);
-        if (buf == NULL)
-            return(NULL);
+            buf = realloc(c->buf, newsz);
+            if (buf == NULL)
+                return(NULL);
 #endif
+        }
         memset(buf + c->limit, 0, newsz - c->limit);
         c->buf = buf;
         c->limit = newsz;
@@ -175,6 +193,14 @@ ndn_charbuf_putf(struct ndn_charbuf *c, const char *fmt, ...)
     return(-1);
 }
 
+/* two decimal digits of v, which is 0..99 */
+static void
+charbuf_put2(char *p, int v)
+{
+    p[0] = '0' + v / 10;
+    p[1] = '0' + v % 10;
+}
+
 /* This formats time into xs:dateTime format */
 int
 ndn_charbuf_append_datetime(struct ndn_charbuf *c, time_t secs, int nsecs)
@@ -182,19 +208,43 @@ ndn_charbuf_append_datetime(struct ndn_charbuf *c, time_t secs, int nsecs)
     char timestring[32];
     int timelen;
     struct tm time_tm;
+    int year;
+    int i;
     int res;
 
-    timelen = strftime(timestring, sizeof(timestring),
-                       "%FT%T", gmtime_r(&secs, &time_tm));
-    if (timelen >= sizeof(timestring))
+    if (gmtime_r(&secs, &time_tm) == NULL)
         return(-1);
+    year = time_tm.tm_year + 1900;
+    if (year >= 1000 && year <= 9999) {
+        /* the usual case, without going through strftime */
+        charbuf_put2(timestring, year / 100);
+        charbuf_put2(timestring + 2, year % 100);
+        timestring[4] = '-';
+        charbuf_put2(timestring + 5, time_tm.tm_mon + 1);
+        timestring[7] = '-';
+        charbuf_put2(timestring + 8, time_tm.tm_mday);
+        timestring[10] = 'T';
+        charbuf_put2(timestring + 11, time_tm.tm_hour);
+        timestring[13] = ':';
+        charbuf_put2(timestring + 14, time_tm.tm_min);
+        timestring[16] = ':';
+        charbuf_put2(timestring + 17, time_tm.tm_sec);
+        timelen = 19;
+    }
+    else {
+        timelen = strftime(timestring, sizeof(timestring), "%FT%T", &time_tm);
+        if (timelen >= sizeof(timestring))
+            return(-1);
+    }
     if (nsecs != 0) {
         if (nsecs < 0 || nsecs >= 1000000000)
             return(-1);
-        timelen += snprintf(&timestring[timelen], sizeof(timestring) - timelen,
-                            ".%09d", nsecs);
-        if (timelen >= sizeof(timestring))
+        if (timelen + 10 >= sizeof(timestring))
             return(-1);
+        timestring[timelen++] = '.';
+        for (i = 9; i > 0; i--, nsecs /= 10)
+            timestring[timelen + i - 1] = '0' + nsecs % 10;
+        timelen += 9;
         while (timestring[timelen - 1] == '0') timelen--;
     }
     timestring[timelen++] = 'Z';
@@ -23,6 +23,7 @@
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdint.h>
@@ -33,7 +34,11 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/un.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 #include <netinet/in.h>
 #include <unistd.h>
 #include <openssl/evp.h>
@@ -51,11 +56,27 @@
 #include <ndn/keystore.h>
 #include <ndn/uri.h>
 
+#include "ndn_arena.h"
+#include "ndn_coding.h"
+#include "ndn_get_many.h"
+#include "ndn_hashtb.h"
+#include "ndn_interest_template.h"
+#include "ndn_io.h"
+#include "ndn_iov.h"
+#include "ndn_keys.h"
+#include "ndn_loop.h"
+#include "ndn_pool.h"
+#include "ndn_rtt.h"
+#include "ndn_signing.h"
+#include "ndn_stream.h"
+
 /* Forward struct declarations */
 struct interests_by_prefix;
 struct expressed_interest;
 struct interest_filter;
 struct ndn_reg_closure;
+struct name_tree_entry;
+struct ndn_content_stream;
 
 /**
  * Handle representing a connection to ndnd
@@ -64,18 +85,39 @@ struct ndn {
     int sock;
     size_t outbufindex;
     struct ndn_charbuf *connect_type;   /* 连接状态 text representing connection to ndnd */
-    struct ndn_charbuf *interestbuf;
+    struct ndn_interest_template *templ; /* last template compiled */
+    struct ndn_charbuf *templ_src;      /* what templ was compiled from */
+    struct ndn_interest_template *key_templ; /* for fetching keys and links */
     struct ndn_charbuf *inbuf;
+    size_t inbufindex;          /* start of unprocessed input in inbuf */
+    size_t inbuf_size;          /* room to keep for each read of input */
     struct ndn_charbuf *outbuf;
+    size_t outbuf_limit;        /* most output to buffer, 0 for no limit */
+    int outbuf_blocked;         /* ndn_put has refused since last drain */
+    ndn_output_drained_action drained; /* tell client it may put again */
+    void *drained_data;
     struct ndn_charbuf *ndndid;
     struct hashtb *interests_by_prefix;
     struct hashtb *interest_filters;
+    struct hashtb *name_tree;   /* prefixes of both tables, by component */
+    struct ndn_charbuf *name_tree_key; /* scratch for name_tree keys */
     struct ndn_skeleton_decoder decoder;
     struct ndn_indexbuf *scratch_indexbuf;
+    struct ndn_arena *arena;    /* scratch for one dispatch cycle */
     struct hashtb *keys;    /* 公钥 public keys, by pubid */
+    struct hashtb_shared *key_cache; /* more, shared with other handles */
     struct hashtb *keystores;   /* unlocked private keys */
     struct ndn_charbuf *default_pubid;
     struct ndn_schedule *schedule;
+    unsigned connects;          /* count of successful ndn_connect calls */
+    struct ndn_schedule *interest_sched; /* expiry of interests and filters */
+    struct interests_by_prefix *dirty_prefixes; /* have retired interests */
+    struct expressed_interest *pub_waiters; /* waiting for keys to arrive */
+    struct ndn_pool *interest_pool; /* expressed_interest and interest_msg */
+    int keys_seen;              /* keys known when waiters last checked */
+    struct ndn_rtt_stats rtt;   /* round trips over the whole handle */
+    struct hashtb *rtt_by_prefix; /* struct ndn_rtt_stats, by parent prefix */
+    int retransmit;             /* resend interests when the RTO expires */
     struct timeval now;
     int timeout;
     int refresh_us;
@@ -85,10 +127,21 @@ struct ndn {
     int tap;
     int running;
     int defer_verification;     /* Client wants to do its own verification */
+    ndn_content_sink sink;      /* takes the content of large objects */
+    void *sink_data;
+    size_t sink_min;            /* smallest content to stream */
+    struct ndn_content_stream *stream; /* object being read, if streaming */
+    struct ndn *spare;          /* connections kept for nested ndn_get */
+    int n_spare;
 };
 
 struct interests_by_prefix { /* keyed by components of name prefix */
     struct expressed_interest *list;
+    struct name_tree_entry *nte; /* our node in h->name_tree */
+    const unsigned char *key;    /* our own key, for deletion */
+    size_t keysize;
+    int dirty;                   /* on the h->dirty_prefixes list */
+    struct interests_by_prefix *next_dirty;
 };
 
 struct expressed_interest {
@@ -97,11 +150,20 @@ struct expressed_interest {
     struct ndn_closure *action;  /* 进来的内容的回调 handler for incoming content */
     unsigned char *interest_msg; /* the interest message as sent */
     size_t size;                 /* its size in bytes */
+    struct ndn_parsed_interest pi; /* interest_msg, already parsed */
+    struct ndn_indexbuf *comps;  /* component boundaries in interest_msg */
     int target;                  /* how many we want outstanding (0 or 1) */
     int outstanding;             /* number currently outstanding (0 or 1) */
     int lifetime_us;             /* interest lifetime in microseconds */
     struct ndn_charbuf *wanted_pub; /* waiting for this pub to arrive */
     struct expressed_interest *next; /* link to next in list */
+    struct interests_by_prefix *owner; /* the entry whose list we are on */
+    struct ndn_scheduled_event *ev; /* pending expiry check, if any */
+    struct expressed_interest *next_waiter; /* link in h->pub_waiters */
+    struct timeval senttime;     /* most recent transmission, or 0 if sampled */
+    int retries;                 /* retransmissions since lasttime */
+    int retransmit;              /* h->retransmit when expressed */
+    struct ndn_rtt_stats *rtt;   /* estimate for our parent prefix */
 };
 
 /**
@@ -112,14 +174,118 @@ struct interest_filter { /* keyed by components of name */
     struct ndn_reg_closure *ndn_reg_closure;
     struct timeval expiry;       /* Time that refresh will be needed */
     int flags;
+    struct name_tree_entry *nte; /* our node in h->name_tree */
+    const unsigned char *key;    /* name prefix components, for refresh */
+    size_t keysize;
+    struct ndn_scheduled_event *ev; /* pending refresh, if any */
 };
 #define NDN_FORW_WAITING_NDNDID (1<<30)
 
+/**
+ * A ContentObject whose content goes to the content sink as it is read
+ *
+ * Only what precedes the content is kept, as the shell of an object
+ * with empty Content, which is what gets dispatched in the end.
+ */
+struct ndn_content_stream {
+    ndn_content_sink sink;
+    void *sink_data;
+    int declined;               /* buffered as usual after all */
+    int failed;                 /* the sink wants no more */
+    struct ndn_charbuf *shell;  /* the object with empty Content */
+    struct ndn_parsed_ContentObject pco; /* parse of shell */
+    struct ndn_indexbuf *comps;
+    struct ndn_sigc *verifier;  /* NULL if verification is deferred */
+    struct ndn_digest *hash;    /* of the entire object */
+    unsigned char digest[32];   /* its result */
+    int verified;               /* as reported for NDN_STREAM_END */
+    size_t content_size;
+    size_t offset;              /* content passed on so far */
+};
+
+/**
+ * Default and minimum amounts of input to ask for in one read
+ */
+#ifndef NDN_INBUF_SIZE
+#define NDN_INBUF_SIZE 65536
+#endif
+#define NDN_INBUF_MIN 8800
+
+/**
+ * Default for the smallest content that goes to a content sink
+ */
+#ifndef NDN_CONTENT_SINK_MIN
+#define NDN_CONTENT_SINK_MIN NDN_INBUF_SIZE
+#endif
+
+/**
+ * Bounds on the retransmission timeout for interests, and its value
+ * before any round trips have been measured
+ */
+#ifndef NDN_RTO_MIN_MICROSEC
+#define NDN_RTO_MIN_MICROSEC 50000
+#endif
+#define NDN_RTO_INITIAL_MICROSEC 1000000
+
+/**
+ * Most prefixes to keep separate round-trip estimates for
+ */
+#ifndef NDN_RTT_MAX_PREFIXES
+#define NDN_RTT_MAX_PREFIXES 1024
+#endif
+
+/**
+ * How many extra connections to keep for calls of ndn_get from upcalls
+ */
+#ifndef NDN_MAX_SPARE_HANDLES
+#define NDN_MAX_SPARE_HANDLES 2
+#endif
+
+/**
+ * Largest interest message kept in the handle's pool; longer ones, and
+ * their records, still come from malloc
+ */
+#ifndef NDN_INTEREST_POOL_MAX
+#define NDN_INTEREST_POOL_MAX 1024
+#endif
+
+/**
+ * Bytes of scratch space that a dispatch cycle can use before its
+ * arena needs another chunk
+ */
+#ifndef NDN_DISPATCH_ARENA_SIZE
+#define NDN_DISPATCH_ARENA_SIZE 8192
+#endif
+
+/**
+ * Name components that scratch indexbufs have room for up front
+ */
+#ifndef NDN_SCRATCH_COMPS
+#define NDN_SCRATCH_COMPS 32
+#endif
+
 struct ndn_reg_closure {
     struct ndn_closure action;
     struct interest_filter *interest_filter; /* Backlink */
 };
 
+/**
+ * Data field for entries in the name_tree hash table
+ *
+ * There is one node for each prefix of a name that has an entry in
+ * interests_by_prefix or interest_filters.  A node is keyed by the address
+ * of its parent node followed by its last ndnb-encoded Component, so
+ * walking down the tree hashes each component only once.
+ */
+struct name_tree_entry {
+    struct name_tree_entry *parent; /* NULL for the root (empty prefix) */
+    const unsigned char *key;    /* our own key, for deletion */
+    size_t keysize;
+    int n_children;              /* number of nodes that have us as parent */
+    struct interests_by_prefix *ipfx; /* entry in interests_by_prefix */
+    struct interest_filter *ifilt;    /* entry in interest_filters */
+};
+
 /* Macros */
 
 #define NOTE_ERR(h, e) (h->err = (e), h->errline = __LINE__, ndn_note_err(h))
@@ -141,6 +307,16 @@ static void finalize_pkey(struct hashtb_enumerator *e);
 static void finalize_keystore(struct hashtb_enumerator *e);
 static int ndn_pushout(struct ndn *h);
 static void update_ifilt_flags(struct ndn *, struct interest_filter *, int);
+static void ndn_arm_interest_timer(struct ndn *, struct expressed_interest *, int);
+static void ndn_arm_ifilt_timer(struct ndn *, struct interest_filter *);
+static void ndn_cancel_timer(struct ndn *, struct ndn_scheduled_event **);
+static void ndn_retire_interest(struct ndn *, struct expressed_interest *);
+static void ndn_note_dirty_prefix(struct ndn *, struct interests_by_prefix *);
+static struct ndn_rtt_stats *ndn_rtt_for_interest(struct ndn *,
+                                                  struct expressed_interest *);
+static void ndn_stream_abort(struct ndn *);
+static int ndn_interest_rto(struct ndn *, struct expressed_interest *);
+static void ndn_note_rtt(struct ndn *, struct expressed_interest *);
 static int update_multifilt(struct ndn *,
                             struct interest_filter *,
                             struct ndn_closure *,
@@ -226,10 +402,18 @@ ndn_geterror(struct ndn *h)
     return(h->err);
 }
 
+/*
+ * While a message is being dispatched, scratch buffers come from the
+ * handle's arena and releasing them is free.  Otherwise one indexbuf
+ * is cached, and charbufs come from the heap.
+ */
 static struct ndn_indexbuf *
 ndn_indexbuf_obtain(struct ndn *h)
 {
-    struct ndn_indexbuf *c = h->scratch_indexbuf;
+    struct ndn_indexbuf *c = ndn_arena_indexbuf(h->arena, NDN_SCRATCH_COMPS);
+    if (c != NULL)
+        return(c);
+    c = h->scratch_indexbuf;
     if (c == NULL)
         return(ndn_indexbuf_create());
     h->scratch_indexbuf = NULL;
@@ -240,6 +424,8 @@ ndn_indexbuf_obtain(struct ndn *h)
 static void
 ndn_indexbuf_release(struct ndn *h, struct ndn_indexbuf *c)
 {
+    if (c == NULL || ndn_arena_owner(c) != NULL)
+        return;
     c->n = 0;
     if (h->scratch_indexbuf == NULL)
         h->scratch_indexbuf = c;
@@ -247,6 +433,15 @@ ndn_indexbuf_release(struct ndn *h, struct ndn_indexbuf *c)
         ndn_indexbuf_destroy(&c);
 }
 
+static struct ndn_charbuf *
+ndn_charbuf_obtain(struct ndn *h, size_t n)
+{
+    struct ndn_charbuf *c = ndn_arena_charbuf(h->arena, n);
+    if (c == NULL)
+        c = ndn_charbuf_create();
+    return(c);
+}
+
 /**
  * Do the refcount updating for closure instances on assignment
  *
@@ -291,7 +486,6 @@ ndn_create(void)
     param.finalize_data = h;
     // sock初始化为-1
     h->sock = -1;
-    h->interestbuf = ndn_charbuf_create();
     param.finalize = &finalize_pkey;
     h->keys = hashtb_create(sizeof(struct ndn_pkey *), &param);
     param.finalize = &finalize_keystore;
@@ -318,10 +512,37 @@ ndn_create(void)
     } else
         h->tap = -1;
     h->defer_verification = 0;
+    h->inbuf_size = NDN_INBUF_SIZE;
+    h->retransmit = 1;
+    h->rtt.rto_us = NDN_RTO_INITIAL_MICROSEC;
     OpenSSL_add_all_algorithms();
     return(h);
 }
 
+/**
+ * Set the amount of input that may be taken from the socket with one read.
+ *
+ * Larger values mean fewer system calls when a lot of content is arriving.
+ * The input buffer will grow beyond this as needed to hold a single
+ * message that is larger.
+ *
+ * @param h is the ndn handle
+ * @param size is the new size in bytes, or 0 to leave unchanged.
+ * @returns previous value, or -1 in case of error.
+ */
+ssize_t
+ndn_set_input_buffer_size(struct ndn *h, size_t size)
+{
+    size_t old;
+
+    if (h == NULL || (size != 0 && size < NDN_INBUF_MIN))
+        return(-1);
+    old = h->inbuf_size;
+    if (size != 0)
+        h->inbuf_size = size;
+    return(old);
+}
+
 /**
  * Tell the library to defer verification.
  *
@@ -356,6 +577,66 @@ ndn_defer_verification(struct ndn *h, int defer)
     return(old);
 }
 
+/**
+ * Have the content of large ContentObjects passed to a sink as it is
+ * read, instead of being buffered whole.
+ *
+ * This applies to objects that are still arriving when the start of
+ * their content is seen, and whose signatures can be checked as they
+ * go by, so that the memory used stays flat whatever their size.
+ * Keys and links are always buffered, as are objects whose keys are
+ * not yet known (unless verification is deferred).  See ndn_stream.h.
+ *
+ * An object already being streamed is finished with the old sink.
+ * @param h is the ndn handle
+ * @param min_size is the smallest content to stream, or 0 for a default.
+ * @param sink is the content sink, or NULL to buffer everything.
+ * @param data is passed to the sink.
+ * @returns 0, or -1 in case of error.
+ */
+int
+ndn_set_content_sink(struct ndn *h, size_t min_size,
+                     ndn_content_sink sink, void *data)
+{
+    if (h == NULL)
+        return(-1);
+    h->sink = sink;
+    h->sink_data = data;
+    h->sink_min = (min_size != 0) ? min_size : NDN_CONTENT_SINK_MIN;
+    return(0);
+}
+
+/**
+ * A content sink that writes all streamed content to a file descriptor
+ *
+ * Content is written as it arrives, before its signature is checked,
+ * so nothing written this way should be trusted.
+ * @param data points to the int file descriptor.
+ */
+int
+ndn_content_sink_fd(enum ndn_stream_kind kind,
+                    const struct ndn_stream_info *info, void *data)
+{
+    int fd = *(int *)data;
+    const unsigned char *p = info->data;
+    size_t size = info->size;
+    ssize_t res;
+
+    if (kind != NDN_STREAM_DATA)
+        return(0);
+    while (size > 0) {
+        res = write(fd, p, size);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return(-1);
+        }
+        p += res;
+        size -= res;
+    }
+    return(0);
+}
+
 /**
  *
  * 参数
@@ -447,6 +728,7 @@ ndn_connect(struct ndn *h, const char *name)
     res = fcntl(h->sock, F_SETFL, O_NONBLOCK);
     if (res == -1)
         return(NOTE_ERRNO(h));
+    h->connects++;
     return(h->sock);
 }
 
@@ -486,7 +768,9 @@ ndn_disconnect(struct ndn *h)
         if (res == 0)
             ndn_pushout(h);
     }
+    ndn_stream_abort(h);
     ndn_charbuf_destroy(&h->inbuf);
+    h->inbufindex = 0;
     ndn_charbuf_destroy(&h->outbuf);
     /* a stored ndndid may no longer be valid */
     ndn_charbuf_destroy(&h->ndndid);
@@ -497,6 +781,7 @@ ndn_disconnect(struct ndn *h)
         for (hashtb_start(h->interest_filters, e); e->data != NULL; hashtb_next(e)) {
             struct interest_filter *i = e->data;
             i->expiry = h->now;
+            ndn_arm_ifilt_timer(h, i);
         }
         hashtb_end(e);
     }
@@ -510,6 +795,10 @@ ndn_disconnect(struct ndn *h)
                 struct expressed_interest *ie;
                 for (ie = entry->list; ie != NULL; ie = ie->next) {
                     ie->outstanding = 0;
+                    if (ie->target != 0) {
+                        ndn_cancel_timer(h, &ie->ev);
+                        ndn_arm_interest_timer(h, ie, 0);
+                    }
                 }
             }
         }
@@ -530,20 +819,40 @@ ndn_gripe(struct expressed_interest *i)
     fprintf(stderr, "BOTCH - (struct expressed_interest *)%p has bad magic value\n", (void *)i);
 }
 
+/**
+ * Replace the message of an expressed interest
+ *
+ * The new message is parsed here, once, so that the matching and timeout
+ * paths can use interest->pi and interest->comps directly.  If it does
+ * not parse, interest_msg is left NULL.
+ */
 static void
-replace_interest_msg(struct expressed_interest *interest,
+replace_interest_msg(struct ndn *h, struct expressed_interest *interest,
                      struct ndn_charbuf *cb)
 {
+    int res;
     if (interest->magic != 0x7059e5f4) {
         ndn_gripe(interest);
         return;
     }
     if (interest->interest_msg != NULL)
-        free(interest->interest_msg);
+        ndn_pool_free(h->interest_pool, interest->interest_msg, interest->size);
     interest->interest_msg = NULL;
     interest->size = 0;
+    memset(&interest->pi, 0, sizeof(interest->pi));
+    if (interest->comps != NULL)
+        interest->comps->n = 0;
     if (cb != NULL && cb->length > 0) {
-        interest->interest_msg = calloc(1, cb->length);
+        if (interest->comps == NULL) {
+            interest->comps = ndn_indexbuf_create();
+            if (interest->comps == NULL)
+                return;
+        }
+        res = ndn_parse_interest(cb->buf, cb->length,
+                                 &interest->pi, interest->comps);
+        if (res < 0)
+            return;
+        interest->interest_msg = ndn_pool_alloc(h->interest_pool, cb->length);
         if (interest->interest_msg != NULL) {
             memcpy(interest->interest_msg, cb->buf, cb->length);
             interest->size = cb->length;
@@ -560,10 +869,21 @@ ndn_destroy_interest(struct ndn *h, struct expressed_interest *i)
         return(NULL);
     }
     ndn_replace_handler(h, &(i->action), NULL);
-    replace_interest_msg(i, NULL);
+    replace_interest_msg(h, i, NULL);
+    ndn_indexbuf_destroy(&i->comps);
+    ndn_cancel_timer(h, &i->ev);
+    if (i->wanted_pub != NULL) {
+        struct expressed_interest **pp;
+        for (pp = &h->pub_waiters; *pp != NULL; pp = &(*pp)->next_waiter) {
+            if (*pp == i) {
+                *pp = i->next_waiter;
+                break;
+            }
+        }
+    }
     ndn_charbuf_destroy(&i->wanted_pub);
     i->magic = -1;
-    free(i);
+    ndn_pool_free(h->interest_pool, i, sizeof(*i));
     return(ans);
 }
 
@@ -608,6 +928,12 @@ ndn_destroy(struct ndn **hp)
     struct ndn *h = *hp;
     if (h == NULL)
         return;
+    while (h->spare != NULL) {
+        struct ndn *spare = h->spare;
+        h->spare = spare->spare;
+        spare->keys = NULL; /* borrowed from us */
+        ndn_destroy(&spare);
+    }
     ndn_schedule_destroy(&h->schedule);
     ndn_disconnect(h);
     if (h->interests_by_prefix != NULL) {
@@ -619,20 +945,29 @@ ndn_destroy(struct ndn **hp)
         hashtb_end(e);
         hashtb_destroy(&(h->interests_by_prefix));
     }
+    hashtb_destroy(&h->rtt_by_prefix);
     if (h->interest_filters != NULL) {
         for (hashtb_start(h->interest_filters, e); e->data != NULL; hashtb_next(e)) {
             struct interest_filter *i = e->data;
+            ndn_cancel_timer(h, &i->ev);
             ndn_replace_handler(h, &(i->action), NULL);
         }
         hashtb_end(e);
         hashtb_destroy(&(h->interest_filters));
     }
+    ndn_schedule_destroy(&h->interest_sched);
+    ndn_pool_destroy(&h->interest_pool);
+    hashtb_destroy(&(h->name_tree));
+    ndn_charbuf_destroy(&h->name_tree_key);
     hashtb_destroy(&(h->keys));
     hashtb_destroy(&(h->keystores));
-    ndn_charbuf_destroy(&h->interestbuf);
+    ndn_interest_template_destroy(&h->templ);
+    ndn_charbuf_destroy(&h->templ_src);
+    ndn_interest_template_destroy(&h->key_templ);
     ndn_charbuf_destroy(&h->inbuf);
     ndn_charbuf_destroy(&h->outbuf);
     ndn_indexbuf_destroy(&h->scratch_indexbuf);
+    ndn_arena_destroy(&h->arena);
     ndn_charbuf_destroy(&h->default_pubid);
     ndn_charbuf_destroy(&h->ndndid);
     ndn_charbuf_destroy(&h->connect_type);
@@ -685,53 +1020,310 @@ ndn_check_namebuf(struct ndn *h, struct ndn_charbuf *namebuf, int prefix_comps,
     return(ans);
 }
 
+/* * * name tree * * */
+
+/**
+ * Number of path entries that name_tree_walk callers keep on the stack
+ */
+#define NAME_TREE_AUTO_PATH 32
+
+/**
+ * Build the name_tree key for the child of parent with the given Component
+ *
+ * The result is left in h->name_tree_key.
+ * @returns pointer to the key, or NULL for error.
+ */
+static unsigned char *
+name_tree_key(struct ndn *h, struct name_tree_entry *parent,
+              const unsigned char *comp, size_t size)
+{
+    struct ndn_charbuf *c = h->name_tree_key;
+    c->length = 0;
+    if (parent != NULL)
+        ndn_charbuf_append(c, &parent, sizeof(parent));
+    if (ndn_charbuf_append(c, comp, size) < 0)
+        return(NULL);
+    return(c->buf);
+}
+
+/**
+ * Table flags for the tables that are consulted for every packet: the
+ * open addressing engine, with growth that does not stall an insertion.
+ * Their keys are names from the network, so use a hash that those
+ * sending the names can't steer into collisions.  Entries come and go
+ * with each interest, so take their nodes from a pool.  Dispatch adds
+ * entries while it holds enumerators on name_tree and
+ * interests_by_prefix; "make check" runs hashtbbench, which tests these
+ * flags used that way.
+ */
+#define NDN_FAST_TABLE_FLAGS \
+    (HASHTB_OPEN_ADDRESSING | HASHTB_INCREMENTAL_REHASH | \
+     HASHTB_SEEDED_HASH | HASHTB_POOLED)
+
+/**
+ * Find or create the name_tree node for a prefix, along with its ancestors
+ *
+ * @param comps points to the sequence of ndnb-encoded Components of the
+ *        prefix (that is, a Name without its outer tag and closer).
+ * @param size is the length of that sequence.
+ * @returns the node, or NULL for error.
+ */
+static struct name_tree_entry *
+name_tree_seek(struct ndn *h, const unsigned char *comps, size_t size)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ndn_skeleton_decoder dd;
+    struct name_tree_entry *parent = NULL;
+    struct name_tree_entry *nte = NULL;
+    unsigned char *key;
+    size_t start = 0;
+    size_t end = 0;
+    int res;
+
+    if (h->name_tree == NULL) {
+        struct hashtb_param param = {0};
+        h->name_tree = hashtb_create_flags(sizeof(struct name_tree_entry),
+                                           &param, NDN_FAST_TABLE_FLAGS);
+        if (h->name_tree == NULL) {
+            NOTE_ERRNO(h);
+            return(NULL);
+        }
+    }
+    if (h->name_tree_key == NULL) {
+        h->name_tree_key = ndn_charbuf_create_n(64);
+        if (h->name_tree_key == NULL) {
+            NOTE_ERRNO(h);
+            return(NULL);
+        }
+    }
+    hashtb_start(h->name_tree, e);
+    for (;;) {
+        key = name_tree_key(h, parent, comps + start, end - start);
+        if (key == NULL) {
+            nte = NULL;
+            break;
+        }
+        res = hashtb_seek(e, key, h->name_tree_key->length, 0);
+        nte = e->data;
+        if (nte == NULL)
+            break;
+        if (res == HT_NEW_ENTRY) {
+            nte->parent = parent;
+            nte->key = e->key;
+            nte->keysize = e->keysize;
+            if (parent != NULL)
+                parent->n_children++;
+        }
+        if (end == size)
+            break;
+        parent = nte;
+        start = end;
+        memset(&dd, 0, sizeof(dd));
+        ndn_skeleton_decode(&dd, comps + start, size - start);
+        if (dd.state != 0 || dd.index <= 0) {
+            nte = NULL;
+            break;
+        }
+        end = start + dd.index;
+    }
+    hashtb_end(e);
+    if (nte == NULL)
+        NOTE_ERR(h, EINVAL);
+    return(nte);
+}
+
+/**
+ * Remove a name_tree node, and then its ancestors, once they are unused
+ *
+ * Callers should clear the node's ipfx or ifilt link first.
+ */
+static void
+name_tree_release(struct ndn *h, struct name_tree_entry *nte)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct name_tree_entry *parent;
+
+    if (h->name_tree == NULL)
+        return;
+    hashtb_start(h->name_tree, e);
+    while (nte != NULL && nte->n_children == 0 &&
+           nte->ipfx == NULL && nte->ifilt == NULL) {
+        parent = nte->parent;
+        if (hashtb_seek(e, nte->key, nte->keysize, 0) != HT_OLD_ENTRY) {
+            THIS_CANNOT_HAPPEN(h);
+            break;
+        }
+        hashtb_delete(e);
+        if (parent != NULL)
+            parent->n_children--;
+        nte = parent;
+    }
+    hashtb_end(e);
+}
+
+/**
+ * Find the name_tree nodes for all of the prefixes of a name at once
+ *
+ * @param msg holds the ndnb-encoded message containing the name.
+ * @param comps holds the Component boundary offsets within msg.
+ * @param path is filled in so that path[i] is the node for the prefix
+ *        with i components; it needs room for comps->n entries.
+ * @returns the number of components in the longest prefix that is present,
+ *          or -1 if there are none.
+ */
+static int
+name_tree_walk(struct ndn *h, const unsigned char *msg,
+               struct ndn_indexbuf *comps, struct name_tree_entry **path)
+{
+    struct name_tree_entry *nte;
+    unsigned char *key;
+    int i;
+
+    if (h->name_tree == NULL)
+        return(-1);
+    nte = hashtb_lookup(h->name_tree, "", 0);
+    for (i = 0; nte != NULL; i++) {
+        path[i] = nte;
+        if (i + 1 >= comps->n)
+            return(i);
+        key = name_tree_key(h, nte, msg + comps->buf[i],
+                            comps->buf[i + 1] - comps->buf[i]);
+        if (key == NULL)
+            return(i);
+        nte = hashtb_lookup(h->name_tree, key, h->name_tree_key->length);
+    }
+    return(i - 1);
+}
+
+/* end of name tree */
+
+/**
+ * Get interest_template compiled.
+ *
+ * Clients tend to pass the same template over and over, so the last
+ * one compiled is kept, and reused if the bytes are the same.
+ * @returns NULL if interest_template does not parse.
+ */
+static const struct ndn_interest_template *
+ndn_compiled_template(struct ndn *h, const struct ndn_charbuf *interest_template)
+{
+    const unsigned char *src = NULL;
+    size_t size = 0;
+
+    if (interest_template != NULL) {
+        src = interest_template->buf;
+        size = interest_template->length;
+        if (size == 0)
+            return(NULL);
+    }
+    if (h->templ != NULL && h->templ_src->length == size &&
+        (size == 0 || memcmp(h->templ_src->buf, src, size) == 0))
+        return(h->templ);
+    ndn_interest_template_destroy(&h->templ);
+    if (h->templ_src == NULL) {
+        h->templ_src = ndn_charbuf_create();
+        if (h->templ_src == NULL)
+            return(NULL);
+    }
+    h->templ_src->length = 0;
+    if (size != 0 && ndn_charbuf_append(h->templ_src, src, size) < 0)
+        return(NULL);
+    h->templ = ndn_interest_template_create(interest_template, 0);
+    return(h->templ);
+}
+
+/**
+ * The template used for fetching keys and resolving links to them.
+ */
+static const struct ndn_interest_template *
+ndn_key_fetch_template(struct ndn *h)
+{
+    struct ndn_charbuf *templ;
+
+    if (h->key_templ != NULL)
+        return(h->key_templ);
+    templ = ndn_charbuf_create();
+    if (templ == NULL)
+        return(NULL);
+    ndn_charbuf_append_tt(templ, NDN_DTAG_Interest, NDN_DTAG);
+    ndn_charbuf_append_tt(templ, NDN_DTAG_Name, NDN_DTAG);
+    ndn_charbuf_append_closer(templ); /* </Name> */
+    ndnb_append_tagged_number(templ, NDN_DTAG_MinSuffixComponents, 1);
+    ndnb_append_tagged_number(templ, NDN_DTAG_MaxSuffixComponents, 3);
+    ndn_charbuf_append_closer(templ); /* </Interest> */
+    h->key_templ = ndn_interest_template_create(templ, 0);
+    ndn_charbuf_destroy(&templ);
+    return(h->key_templ);
+}
+
+/**
+ * Make the message of an expressed interest from a compiled template.
+ *
+ * Unlike replace_interest_msg, this writes straight into the storage
+ * of the message, and parses nothing but the name.
+ */
+static void
+emit_interest_msg(struct ndn *h, struct expressed_interest *interest,
+                  const struct ndn_interest_template *t,
+                  const unsigned char *name, size_t name_size)
+{
+    size_t size;
+    int res;
+
+    replace_interest_msg(h, interest, NULL);
+    if (interest->magic != 0x7059e5f4)
+        return;
+    if (interest->comps == NULL) {
+        interest->comps = ndn_indexbuf_create();
+        if (interest->comps == NULL)
+            return;
+    }
+    res = ndn_interest_template_parsed(t, name, name_size,
+                                       &interest->pi, interest->comps);
+    if (res < 0) {
+        memset(&interest->pi, 0, sizeof(interest->pi));
+        interest->comps->n = 0;
+        return;
+    }
+    size = ndn_interest_template_size(t, name_size);
+    interest->interest_msg = ndn_pool_alloc(h->interest_pool, size);
+    if (interest->interest_msg != NULL) {
+        ndn_interest_template_emit(t, name, name_size, NULL,
+                                   interest->interest_msg, size);
+        interest->size = size;
+    }
+}
+
 static void
 ndn_construct_interest(struct ndn *h,
                        struct ndn_charbuf *name_prefix,
-                       struct ndn_charbuf *interest_template,
+                       const struct ndn_interest_template *t,
                        struct expressed_interest *dest)
 {
-    struct ndn_charbuf *c = h->interestbuf;
-    size_t start;
-    size_t size;
-    int res;
+    intmax_t lifetime;
 
     dest->lifetime_us = NDN_INTEREST_LIFETIME_MICROSEC;
-    c->length = 0;
-    ndn_charbuf_append_tt(c, NDN_DTAG_Interest, NDN_DTAG);
-    ndn_charbuf_append(c, name_prefix->buf, name_prefix->length);
-    res = 0;
-    if (interest_template != NULL) {
-        struct ndn_parsed_interest pi = { 0 };
-        res = ndn_parse_interest(interest_template->buf,
-                                 interest_template->length, &pi, NULL);
-        if (res >= 0) {
-            intmax_t lifetime = ndn_interest_lifetime(interest_template->buf, &pi);
-            // XXX - for now, don't try to handle lifetimes over 30 seconds.
-            if (lifetime < 1 || lifetime > (30 << 12))
-                NOTE_ERR(h, EINVAL);
-            else
-                dest->lifetime_us = (lifetime * 1000000) >> 12;
-            start = pi.offset[NDN_PI_E_Name];
-            size = pi.offset[NDN_PI_B_Nonce] - start;
-            ndn_charbuf_append(c, interest_template->buf + start, size);
-            start = pi.offset[NDN_PI_B_OTHER];
-            size = pi.offset[NDN_PI_E_OTHER] - start;
-            if (size != 0)
-                ndn_charbuf_append(c, interest_template->buf + start, size);
-        }
-        else
-            NOTE_ERR(h, EINVAL);
+    if (t == NULL) {
+        NOTE_ERR(h, EINVAL);
+        replace_interest_msg(h, dest, NULL);
+        return;
     }
-    ndn_charbuf_append_closer(c);
-    replace_interest_msg(dest, (res >= 0 ? c : NULL));
+    lifetime = ndn_interest_template_lifetime(t);
+    // XXX - for now, don't try to handle lifetimes over 30 seconds.
+    if (lifetime < 1 || lifetime > (30 << 12))
+        NOTE_ERR(h, EINVAL);
+    else
+        dest->lifetime_us = (lifetime * 1000000) >> 12;
+    emit_interest_msg(h, dest, t, name_prefix->buf, name_prefix->length);
 }
 
-int
-ndn_express_interest(struct ndn *h,
-                     struct ndn_charbuf *namebuf,
-                     struct ndn_closure *action,
-                     struct ndn_charbuf *interest_template)
+static int
+express_interest(struct ndn *h,
+                 struct ndn_charbuf *namebuf,
+                 struct ndn_closure *action,
+                 const struct ndn_interest_template *t)
 {
     struct hashtb_enumerator ee;
     struct hashtb_enumerator *e = &ee;
@@ -740,10 +1332,17 @@ ndn_express_interest(struct ndn *h,
     struct expressed_interest *interest = NULL;
     struct interests_by_prefix *entry = NULL;
     if (h->interests_by_prefix == NULL) {
-        h->interests_by_prefix = hashtb_create(sizeof(struct interests_by_prefix), NULL);
+        struct hashtb_param param = {0};
+        h->interests_by_prefix = hashtb_create_flags(sizeof(struct interests_by_prefix),
+                                                     &param, NDN_FAST_TABLE_FLAGS);
         if (h->interests_by_prefix == NULL)
             return(NOTE_ERRNO(h));
     }
+    if (h->interest_pool == NULL) {
+        h->interest_pool = ndn_pool_create(NDN_INTEREST_POOL_MAX);
+        if (h->interest_pool == NULL)
+            return(NOTE_ERRNO(h));
+    }
     prefixend = ndn_check_namebuf(h, namebuf, -1, 1);
     if (prefixend < 0)
         return(prefixend);
@@ -761,19 +1360,32 @@ ndn_express_interest(struct ndn *h,
         hashtb_end(e);
         return(res);
     }
-    if (res == HT_NEW_ENTRY)
+    if (res == HT_NEW_ENTRY) {
         entry->list = NULL;
-    interest = calloc(1, sizeof(*interest));
+        entry->key = e->key;
+        entry->keysize = e->keysize;
+        entry->nte = name_tree_seek(h, namebuf->buf + 1, prefixend - 1);
+        if (entry->nte == NULL) {
+            hashtb_delete(e);
+            hashtb_end(e);
+            return(-1);
+        }
+        entry->nte->ipfx = entry;
+    }
+    interest = ndn_pool_alloc(h->interest_pool, sizeof(*interest));
     if (interest == NULL) {
         NOTE_ERRNO(h);
+        ndn_note_dirty_prefix(h, entry);
         hashtb_end(e);
         return(-1);
     }
     interest->magic = 0x7059e5f4;
     // 构造一个空的interest。输出是interest
-    ndn_construct_interest(h, namebuf, interest_template, interest);
+    ndn_construct_interest(h, namebuf, t, interest);
     if (interest->interest_msg == NULL) {
-        free(interest);
+        ndn_indexbuf_destroy(&interest->comps);
+        ndn_pool_free(h->interest_pool, interest, sizeof(*interest));
+        ndn_note_dirty_prefix(h, entry);
         hashtb_end(e);
         return(-1);
     }
@@ -781,6 +1393,9 @@ ndn_express_interest(struct ndn *h,
     // 之后interest的action就是我们自定义的了。h不变
     ndn_replace_handler(h, &(interest->action), action);
     interest->target = 1;
+    interest->owner = entry;
+    interest->rtt = ndn_rtt_for_interest(h, interest);
+    interest->retransmit = h->retransmit;
     // 把找到的interest信息装入
     interest->next = entry->list;
     entry->list = interest;
@@ -791,11 +1406,44 @@ ndn_express_interest(struct ndn *h,
     return(0);
 }
 
-static void
-finalize_interest_filter(struct hashtb_enumerator *e)
+int
+ndn_express_interest(struct ndn *h,
+                     struct ndn_charbuf *namebuf,
+                     struct ndn_closure *action,
+                     struct ndn_charbuf *interest_template)
 {
-    struct interest_filter *i = e->data;
-    if (i->ndn_reg_closure != NULL) {
+    return(express_interest(h, namebuf, action,
+                            ndn_compiled_template(h, interest_template)));
+}
+
+/**
+ * Express an interest made from a compiled template.
+ *
+ * This is ndn_express_interest for clients that express many interests
+ * of the same form, such as segment fetchers and polling consumers.
+ * The template is not parsed again, and may be shared by handles.
+ * @param t is from ndn_interest_template_create with a nonce_size of 0;
+ *        ndnd supplies the Nonce.  A template with a Nonce is refused
+ *        with EINVAL, since the one message is sent again on every
+ *        refresh and retransmission, and ndnd would drop those as
+ *        duplicates.
+ */
+int
+ndn_express_interest_compiled(struct ndn *h,
+                              struct ndn_charbuf *namebuf,
+                              struct ndn_closure *action,
+                              const struct ndn_interest_template *t)
+{
+    if (t == NULL || ndn_interest_template_nonce_size(t) != 0)
+        return(NOTE_ERR(h, EINVAL));
+    return(express_interest(h, namebuf, action, t));
+}
+
+static void
+finalize_interest_filter(struct hashtb_enumerator *e)
+{
+    struct interest_filter *i = e->data;
+    if (i->ndn_reg_closure != NULL) {
         i->ndn_reg_closure->interest_filter = NULL;
         i->ndn_reg_closure = NULL;
     }
@@ -831,7 +1479,8 @@ ndn_set_interest_filter_with_flags(struct ndn *h, struct ndn_charbuf *namebuf,
     if (h->interest_filters == NULL) {
         struct hashtb_param param = {0};
         param.finalize = &finalize_interest_filter;
-        h->interest_filters = hashtb_create(sizeof(struct interest_filter), &param);
+        h->interest_filters = hashtb_create_flags(sizeof(struct interest_filter),
+                                                  &param, NDN_FAST_TABLE_FLAGS);
         if (h->interest_filters == NULL)
             return(NOTE_ERRNO(h));
     }
@@ -842,14 +1491,34 @@ ndn_set_interest_filter_with_flags(struct ndn *h, struct ndn_charbuf *namebuf,
     res = hashtb_seek(e, namebuf->buf + 1, namebuf->length - 2, 0);
     if (res >= 0) {
         entry = e->data;
+        if (res == HT_NEW_ENTRY) {
+            entry->key = e->key;
+            entry->keysize = e->keysize;
+        }
+        if (res == HT_NEW_ENTRY && action != NULL) {
+            entry->nte = name_tree_seek(h, namebuf->buf + 1, namebuf->length - 2);
+            if (entry->nte == NULL) {
+                hashtb_delete(e);
+                hashtb_end(e);
+                return(-1);
+            }
+            entry->nte->ifilt = entry;
+        }
         if (entry->action != NULL && action != NULL && action != entry->action)
             res = update_multifilt(h, entry, action, forw_flags);
         else {
             update_ifilt_flags(h, entry, forw_flags);
             ndn_replace_handler(h, &(entry->action), action);
         }
-        if (entry->action == NULL)
+        if (entry->action == NULL) {
+            if (entry->nte != NULL) {
+                entry->nte->ifilt = NULL;
+                name_tree_release(h, entry->nte);
+                entry->nte = NULL;
+            }
+            ndn_cancel_timer(h, &entry->ev);
             hashtb_delete(e);
+        }
     }
     hashtb_end(e);
     return(res);
@@ -909,6 +1578,7 @@ update_ifilt_flags(struct ndn *h, struct interest_filter *f, int forw_flags)
     if (f->flags != forw_flags) {
         memset(&f->expiry, 0, sizeof(f->expiry));
         f->flags = forw_flags;
+        ndn_arm_ifilt_timer(h, f);
     }
 }
 
@@ -1146,58 +1816,102 @@ ndn_pushout(struct ndn *h)
     ssize_t res;
     size_t size;
     if (h->outbuf != NULL && h->outbufindex < h->outbuf->length) {
-      // puts(h->outbuf->buf);
-      // puts("lll");
         if (h->sock < 0)
             return(1);
         size = h->outbuf->length - h->outbufindex;
         res = write(h->sock, h->outbuf->buf + h->outbufindex, size);
-        if (res == size) {
-            h->outbuf->length = h->outbufindex = 0;
-            return(0);
-        }
         if (res == -1)
             return ((errno == EAGAIN) ? 1 : NOTE_ERRNO(h));
-        h->outbufindex += res;
-        return(1);
+        if (res < size) {
+            h->outbufindex += res;
+            return(1);
+        }
+        h->outbuf->length = h->outbufindex = 0;
+    }
+    if (h->outbuf_blocked) {
+        h->outbuf_blocked = 0;
+        if (h->drained != NULL)
+            (h->drained)(h, h->drained_data);
     }
     return(0);
 }
 
-// p是消息
+/**
+ * Send a message that is in pieces, such as one from
+ * ndn_sign_content_iov, without putting it together first.
+ *
+ * The pieces go out with writev, along with any output already waiting.
+ * They are only copied if not all of them can be written right away.
+ * Otherwise this is the same as ndn_put.
+ * @param iov describes the pieces of one ndnb-encoded message.
+ * @param iovcnt is the number of pieces, at most NDN_PUT_IOV_MAX.
+ * @returns 0 if the message was sent, 1 if it was buffered,
+ *          or -1 for error.
+ */
 int
-ndn_put(struct ndn *h, const void *p, size_t length)
+ndn_put_iov(struct ndn *h, const struct iovec *iov, int iovcnt)
 {
     struct ndn_skeleton_decoder dd = {0};
+    struct iovec out[1 + NDN_PUT_IOV_MAX];
+    size_t length = 0;
+    size_t pending = 0;
     ssize_t res;
+    int i;
+    int n;
     if (h == NULL)
         return(-1);
-    if (p == NULL || length == 0)
+    if (iov == NULL || iovcnt <= 0 || iovcnt > NDN_PUT_IOV_MAX)
         return(NOTE_ERR(h, EINVAL));
-    // 解码输入参数p
-    res = ndn_skeleton_decode(&dd, p, length);
-    if (!(res == length && dd.state == 0))
+    // 解码输入参数，要正好是一个完整的消息
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0)
+            continue;
+        if (length != 0 && dd.state == 0)
+            return(NOTE_ERR(h, EINVAL)); /* more than one message */
+        res = ndn_skeleton_decode(&dd, iov[i].iov_base, iov[i].iov_len);
+        if (res != iov[i].iov_len)
+            return(NOTE_ERR(h, EINVAL));
+        length += iov[i].iov_len;
+    }
+    if (length == 0 || dd.state != 0)
         return(NOTE_ERR(h, EINVAL));
+    if (ndn_output_is_pending(h))
+        pending = h->outbuf->length - h->outbufindex;
+    if (h->outbuf_limit != 0 && pending != 0 &&
+        pending + length > h->outbuf_limit) {
+        h->outbuf_blocked = 1;
+        return(NOTE_ERR(h, EAGAIN));
+    }
     if (h->tap != -1) {
-        res = write(h->tap, p, length);
+        res = writev(h->tap, iov, iovcnt);
         if (res == -1) {
             NOTE_ERRNO(h);
             (void)close(h->tap);
             h->tap = -1;
         }
     }
-    if (h->outbuf != NULL && h->outbufindex < h->outbuf->length) {
-        // XXX - should limit unbounded growth of h->outbuf
-        // 把传入参数p的内容加到本ndn client实体的outbuf上。
-        ndn_charbuf_append(h->outbuf, p, length); // XXX - check res
-        // 把h的outbuf打到h的sock上。
-        return (ndn_pushout(h));
+    if (h->sock == -1 || h->running != 0)
+        res = 0; /* ndn_pushout will send it */
+    else {
+        n = 0;
+        if (pending != 0) {
+            out[n].iov_base = h->outbuf->buf + h->outbufindex;
+            out[n++].iov_len = pending;
+        }
+        for (i = 0; i < iovcnt; i++)
+            out[n++] = iov[i];
+        res = writev(h->sock, out, n);
+        if (pending != 0) {
+            if (res >= 0 && (size_t)res >= pending) {
+                h->outbuf->length = h->outbufindex = 0;
+                res -= pending;
+            }
+            else if (res > 0) {
+                h->outbufindex += res;
+                res = 0;
+            }
+        }
     }
-    if (h->sock == -1)
-        res = 0;
-    else
-        // 往h的sock上再写p？？？
-        res = write(h->sock, p, length);
     if (res == length)
         return(0);
     if (res == -1) {
@@ -1208,11 +1922,91 @@ ndn_put(struct ndn *h, const void *p, size_t length)
     if (h->outbuf == NULL) {
         h->outbuf = ndn_charbuf_create();
         h->outbufindex = 0;
+        if (h->outbuf == NULL)
+            return(NOTE_ERRNO(h));
+    }
+    /* Keep whatever was not written */
+    for (i = 0; i < iovcnt; i++) {
+        if ((size_t)res >= iov[i].iov_len) {
+            res -= iov[i].iov_len;
+            continue;
+        }
+        if (ndn_charbuf_append(h->outbuf,
+                               (const unsigned char *)iov[i].iov_base + res,
+                               iov[i].iov_len - res) < 0)
+            return(NOTE_ERRNO(h));
+        res = 0;
     }
-    ndn_charbuf_append(h->outbuf, ((const unsigned char *)p)+res, length-res);
     return(1);
 }
 
+/**
+ * Send a message to ndnd, buffering it if it cannot be sent right away.
+ *
+ * Messages put from within upcalls are held until the upcalls are done,
+ * so that they can go out together with a single write.  When output is
+ * already waiting, it is written with the new message using writev, so
+ * the new message is only copied if it does not all fit.
+ *
+ * If an output limit has been set with ndn_set_output_limit and the
+ * message would take the buffered output over it, the message is refused
+ * and the handle error is set to EAGAIN; the action set with
+ * ndn_set_output_drained_action is called once the output has drained.
+ * A message is always accepted when no output is waiting, however large,
+ * so that a producer retrying from the action cannot be refused forever.
+ *
+ * @returns 0 if the message was sent, 1 if it was buffered,
+ *          or -1 for error.
+ */
+int
+ndn_put(struct ndn *h, const void *p, size_t length)
+{
+    struct iovec iov;
+    if (h == NULL)
+        return(-1);
+    if (p == NULL || length == 0)
+        return(NOTE_ERR(h, EINVAL));
+    iov.iov_base = (void *)p;
+    iov.iov_len = length;
+    return(ndn_put_iov(h, &iov, 1));
+}
+
+/**
+ * Limit the amount of output that ndn_put will buffer.
+ *
+ * @param h is the ndn handle
+ * @param limit is the new limit in bytes, or 0 for no limit (the default).
+ * @returns the previous limit.
+ */
+size_t
+ndn_set_output_limit(struct ndn *h, size_t limit)
+{
+    size_t old = h->outbuf_limit;
+    h->outbuf_limit = limit;
+    return(old);
+}
+
+/**
+ * Set the action to call when output drains after ndn_put has refused
+ * a message because of the output limit.
+ *
+ * The action is called from within ndn_run, and may call ndn_put.
+ * @param h is the ndn handle
+ * @param action is the action, or NULL for none.
+ * @param data is passed to the action.
+ * @returns 0 for success, -1 for error.
+ */
+int
+ndn_set_output_drained_action(struct ndn *h,
+                              ndn_output_drained_action action, void *data)
+{
+    if (h == NULL)
+        return(-1);
+    h->drained = action;
+    h->drained_data = data;
+    return(0);
+}
+
 int
 ndn_output_is_pending(struct ndn *h)
 {
@@ -1234,6 +2028,7 @@ static void
 ndn_refresh_interest(struct ndn *h, struct expressed_interest *interest)
 {
     int res;
+    int rto;
     if (interest->magic != 0x7059e5f4) {
         ndn_gripe(interest);
         return;
@@ -1246,8 +2041,17 @@ ndn_refresh_interest(struct ndn *h, struct expressed_interest *interest)
             if (h->now.tv_sec == 0)
                 gettimeofday(&h->now, NULL);
             interest->lasttime = h->now;
+            gettimeofday(&interest->senttime, NULL);
+            interest->retries = 0;
+            rto = ndn_interest_rto(h, interest);
+            if (rto < interest->lifetime_us) {
+                /* a pending check would come too late to retransmit */
+                ndn_cancel_timer(h, &interest->ev);
+                ndn_arm_interest_timer(h, interest, rto);
+            }
         }
     }
+    ndn_arm_interest_timer(h, interest, interest->lifetime_us);
 }
 
 static int
@@ -1300,17 +2104,72 @@ ndn_digest_Content(const unsigned char *content_object,
     ndn_digest_destroy(&d);
 }
 
+/**
+ * Find a public key by pubid, in the handle's own keys or in the
+ * shared key cache.
+ * @returns the key, or NULL if we don't know it.
+ */
+static struct ndn_pkey *
+ndn_find_pkey(struct ndn *h, const unsigned char *pkeyid, size_t pkeyid_size)
+{
+    struct ndn_pkey **entry;
+
+    entry = hashtb_lookup(h->keys, pkeyid, pkeyid_size);
+    if (entry == NULL && h->key_cache != NULL)
+        entry = hashtb_shared_lookup(h->key_cache, pkeyid, pkeyid_size);
+    return(entry != NULL ? *entry : NULL);
+}
+
+/**
+ * Remember a public key, in the shared key cache if the handle has one.
+ *
+ * If the key is already known (perhaps because another thread got
+ * there first), pkey is freed in favor of the one we had.
+ * @returns the key now stored under pkeyid, or NULL for error.
+ */
+static struct ndn_pkey *
+ndn_keep_pkey(struct ndn *h, const unsigned char *pkeyid, size_t pkeyid_size,
+              struct ndn_pkey *pkey)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ndn_pkey **entry;
+    int res;
+
+    if (pkey == NULL)
+        return(NULL);
+    if (h->key_cache != NULL) {
+        entry = hashtb_shared_insert(h->key_cache, pkeyid, pkeyid_size, 0,
+                                     &pkey, &res);
+        if (entry == NULL)
+            NOTE_ERRNO(h);
+    }
+    else {
+        hashtb_start(h->keys, e);
+        res = hashtb_seek(e, pkeyid, pkeyid_size, 0);
+        entry = e->data;
+        if (res == HT_NEW_ENTRY)
+            *entry = pkey;
+        else if (res < 0)
+            NOTE_ERRNO(h);
+        hashtb_end(e);
+    }
+    if (entry == NULL || *entry != pkey)
+        ndn_pubkey_free(pkey);
+    return(entry != NULL ? *entry : NULL);
+}
+
 static int
 ndn_cache_key(struct ndn *h,
               const unsigned char *ndnb, size_t size,
               struct ndn_parsed_ContentObject *pco)
 {
     int type;
-    struct ndn_pkey **entry;
-    struct hashtb_enumerator ee;
-    struct hashtb_enumerator *e = &ee;
     int res;
     unsigned char digest[32];
+    struct ndn_pkey *pkey;
+    const unsigned char *data = NULL;
+    size_t data_size = 0;
 
     type = ndn_get_content_type(ndnb, pco);
     if (type != NDN_CONTENT_KEY) {
@@ -1319,33 +2178,16 @@ ndn_cache_key(struct ndn *h,
 
     ndn_digest_Content(ndnb, pco, digest, sizeof(digest));
 
-    hashtb_start(h->keys, e);
-    res = hashtb_seek(e, (void *)digest, sizeof(digest), 0);
-    if (res < 0) {
-        hashtb_end(e);
+    if (ndn_find_pkey(h, digest, sizeof(digest)) != NULL)
+        return (0);
+    res = ndn_content_get_value(ndnb, size, pco, &data, &data_size);
+    if (res < 0)
         return(NOTE_ERRNO(h));
-    }
-    entry = e->data;
-    if (res == HT_NEW_ENTRY) {
-        struct ndn_pkey *pkey;
-        const unsigned char *data = NULL;
-        size_t data_size = 0;
-
-        res = ndn_content_get_value(ndnb, size, pco, &data, &data_size);
-        if (res < 0) {
-            hashtb_delete(e);
-            hashtb_end(e);
-            return(NOTE_ERRNO(h));
-        }
-        pkey = ndn_d2i_pubkey(data, data_size);
-        if (pkey == NULL) {
-            hashtb_delete(e);
-            hashtb_end(e);
-            return(NOTE_ERRNO(h));
-        }
-        *entry = pkey;
-    }
-    hashtb_end(e);
+    pkey = ndn_d2i_pubkey(data, data_size);
+    if (pkey == NULL)
+        return(NOTE_ERRNO(h));
+    if (ndn_keep_pkey(h, digest, sizeof(digest), pkey) == NULL)
+        return(-1);
     return (0);
 }
 
@@ -1357,6 +2199,140 @@ finalize_pkey(struct hashtb_enumerator *e)
         ndn_pubkey_free(*entry);
 }
 
+/**
+ * Create a cache of public keys that several handles, possibly in
+ * different threads, can share.  See ndn_set_key_cache().
+ * @returns the cache, or NULL for error.
+ */
+struct hashtb_shared *
+ndn_key_cache_create(void)
+{
+    struct hashtb_param param = {0};
+    param.finalize = &finalize_pkey;
+    return(hashtb_shared_create(sizeof(struct ndn_pkey *), &param,
+                                HASHTB_SEEDED_HASH));
+}
+
+/**
+ * Have the handle look for public keys in a shared cache, and put the
+ * ones it learns there.
+ *
+ * Keys the handle already knows stay in its own table.  The cache is
+ * not owned by the handle; free it with hashtb_shared_destroy once no
+ * handle is using it.
+ * @param cache is from ndn_key_cache_create, or NULL to stop sharing.
+ * @returns the cache that was in use before, or NULL.
+ */
+struct hashtb_shared *
+ndn_set_key_cache(struct ndn *h, struct hashtb_shared *cache)
+{
+    struct hashtb_shared *old = h->key_cache;
+    h->key_cache = cache;
+    return(old);
+}
+
+/**
+ * Save the public keys that the handle knows to a file.
+ *
+ * The file is a hashtb snapshot keyed by publisher public key digest,
+ * with each key's DER encoding, as a BLOB, following the digest.
+ * @returns 0, or -1 for error.
+ */
+int
+ndn_save_keys(struct ndn *h, const char *path)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct hashtb_enumerator ss;
+    struct hashtb_enumerator *s = &ss;
+    struct hashtb *saved;
+    struct ndn_charbuf *c;
+    struct ndn_pkey **entry;
+    int res = 0;
+
+    saved = hashtb_create(0, NULL);
+    c = ndn_charbuf_create();
+    if (saved == NULL || c == NULL) {
+        hashtb_destroy(&saved);
+        ndn_charbuf_destroy(&c);
+        return(NOTE_ERRNO(h));
+    }
+    hashtb_start(saved, s);
+    for (hashtb_start(h->keys, e); e->key != NULL; hashtb_next(e)) {
+        entry = e->data;
+        c->length = 0;
+        ndn_charbuf_append(c, e->key, e->keysize);
+        if (*entry == NULL || ndn_append_pubkey_blob(c, *entry) < 0)
+            continue;
+        res = hashtb_seek(s, c->buf, e->keysize, c->length - e->keysize);
+        if (res < 0)
+            break;
+    }
+    hashtb_end(e);
+    hashtb_end(s);
+    if (res >= 0)
+        res = hashtb_snapshot_write(saved, path);
+    if (res < 0)
+        NOTE_ERRNO(h);
+    hashtb_destroy(&saved);
+    ndn_charbuf_destroy(&c);
+    return(res < 0 ? -1 : 0);
+}
+
+/**
+ * Add the public keys saved by ndn_save_keys to those the handle knows.
+ *
+ * The snapshot is mapped rather than read, and h->keys is grown just
+ * once, so this is cheap even for many keys.
+ * @returns the number of keys added, or -1 for error.
+ */
+int
+ndn_load_keys(struct ndn *h, const char *path)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct hashtb_enumerator ss;
+    struct hashtb_enumerator *s = &ss;
+    struct ndn_buf_decoder decoder;
+    struct ndn_buf_decoder *d;
+    struct hashtb *saved;
+    struct ndn_pkey **entry;
+    const unsigned char *der;
+    size_t der_size;
+    int added = 0;
+    int res;
+
+    saved = hashtb_snapshot_open(path);
+    if (saved == NULL)
+        return(NOTE_ERRNO(h));
+    hashtb_reserve(h->keys, hashtb_n(h->keys) + hashtb_n(saved));
+    hashtb_start(h->keys, e);
+    for (hashtb_start(saved, s); s->key != NULL; hashtb_next(s)) {
+        d = ndn_buf_decoder_start(&decoder,
+                                  (const unsigned char *)s->key + s->keysize,
+                                  s->extsize);
+        if (!ndn_buf_match_blob(d, &der, &der_size))
+            continue;
+        res = hashtb_seek(e, s->key, s->keysize, 0);
+        if (res < 0) {
+            added = NOTE_ERRNO(h);
+            break;
+        }
+        if (res == HT_NEW_ENTRY) {
+            entry = e->data;
+            *entry = ndn_d2i_pubkey(der, der_size);
+            if (*entry == NULL)
+                hashtb_delete(e);
+            else
+                added++;
+        }
+    }
+    hashtb_end(s);
+    hashtb_end(e);
+    hashtb_destroy(&saved);
+    return(added);
+}
+
 /**
  * Examine a ContentObject and try to find the public key needed to
  * verify it.  It might be present in our cache of keys, or in the
@@ -1376,7 +2352,6 @@ ndn_locate_key(struct ndn *h,
     int res;
     const unsigned char *pkeyid;
     size_t pkeyid_size;
-    struct ndn_pkey **entry;
     struct ndn_buf_decoder decoder;
     struct ndn_buf_decoder *d;
 
@@ -1390,11 +2365,9 @@ ndn_locate_key(struct ndn *h,
                               &pkeyid, &pkeyid_size);
     if (res < 0)
         return (NOTE_ERR(h, res));
-    entry = hashtb_lookup(h->keys, pkeyid, pkeyid_size);
-    if (entry != NULL) {
-        *pubkey = *entry;
+    *pubkey = ndn_find_pkey(h, pkeyid, pkeyid_size);
+    if (*pubkey != NULL)
         return (0);
-    }
     /* Is a key locator present? */
     if (pco->offset[NDN_PCO_B_KeyLocator] == pco->offset[NDN_PCO_E_KeyLocator])
         return (-1);
@@ -1411,8 +2384,6 @@ ndn_locate_key(struct ndn *h,
         struct ndn_digest *digest = NULL;
         unsigned char *key_digest = NULL;
         size_t key_digest_size;
-        struct hashtb_enumerator ee;
-        struct hashtb_enumerator *e = &ee;
 
         res = ndn_ref_tagged_BLOB(NDN_DTAG_Key, msg,
                                   pco->offset[NDN_PCO_B_Key_Certificate_KeyName],
@@ -1429,21 +2400,11 @@ ndn_locate_key(struct ndn *h,
         res = ndn_digest_final(digest, key_digest, key_digest_size);
         if (res < 0) abort();
         ndn_digest_destroy(&digest);
-        hashtb_start(h->keys, e);
-        res = hashtb_seek(e, (void *)key_digest, key_digest_size, 0);
+        *pubkey = ndn_keep_pkey(h, key_digest, key_digest_size, *pubkey);
         free(key_digest);
         key_digest = NULL;
-        if (res < 0) {
-            hashtb_end(e);
-            return(NOTE_ERRNO(h));
-        }
-        entry = e->data;
-        if (res == HT_NEW_ENTRY) {
-            *entry = *pubkey;
-        }
-        else
-            THIS_CANNOT_HAPPEN(h);
-        hashtb_end(e);
+        if (*pubkey == NULL)
+            return(-1);
         return (0);
     }
     else if (ndn_buf_match_dtag(d, NDN_DTAG_Certificate)) {
@@ -1501,7 +2462,6 @@ handle_key(struct ndn_closure *selfp,
     size_t data_size;
     int res;
     struct ndn_charbuf *name = NULL;
-    struct ndn_charbuf *templ = NULL;
 
     switch(kind) {
         case NDN_UPCALL_FINAL:
@@ -1530,23 +2490,16 @@ handle_key(struct ndn_closure *selfp,
                                             &data, &data_size);
                 if (res < 0)
                     return (NDN_UPCALL_RESULT_ERR);
-                templ = ndn_charbuf_create();
-                ndn_charbuf_append_tt(templ, NDN_DTAG_Interest, NDN_DTAG);
-                ndn_charbuf_append_tt(templ, NDN_DTAG_Name, NDN_DTAG);
-                ndn_charbuf_append_closer(templ); /* </Name> */
-                ndnb_tagged_putf(templ, NDN_DTAG_MinSuffixComponents, "%d", 1);
-                ndnb_tagged_putf(templ, NDN_DTAG_MaxSuffixComponents, "%d", 3);
-                ndn_charbuf_append_closer(templ); /* </Interest> */
-                name = ndn_charbuf_create();
+                name = ndn_charbuf_obtain(h, data_size);
                 res = ndn_append_link_name(name, data, data_size);
                 if (res < 0) {
                     NOTE_ERR(h, EINVAL);
                     res = NDN_UPCALL_RESULT_ERR;
                 }
                 else
-                    res = ndn_express_interest(h, name, selfp, templ);
+                    res = express_interest(h, name, selfp,
+                                           ndn_key_fetch_template(h));
                 ndn_charbuf_destroy(&name);
-                ndn_charbuf_destroy(&templ);
                 return(res);
             }
             return (NDN_UPCALL_RESULT_ERR);
@@ -1584,8 +2537,15 @@ ndn_initiate_key_fetch(struct ndn *h,
 
     if (trigger_interest != NULL) {
         /* Arrange a wakeup when the key arrives */
-        if (trigger_interest->wanted_pub == NULL)
+        if (trigger_interest->wanted_pub == NULL) {
             trigger_interest->wanted_pub = ndn_charbuf_create();
+            if (trigger_interest->wanted_pub != NULL) {
+                trigger_interest->next_waiter = h->pub_waiters;
+                h->pub_waiters = trigger_interest;
+            }
+        }
+        /* the key may already be here, so look on the next pass */
+        h->keys_seen = -1;
         res = ndn_ref_tagged_BLOB(NDN_DTAG_PublisherPublicKeyDigest, msg,
                                   pco->offset[NDN_PCO_B_PublisherPublicKeyDigest],
                                   pco->offset[NDN_PCO_E_PublisherPublicKeyDigest],
@@ -1595,6 +2555,8 @@ ndn_initiate_key_fetch(struct ndn *h,
             ndn_charbuf_append(trigger_interest->wanted_pub, pkeyid, pkeyid_size);
         }
         trigger_interest->target = 0;
+        if (trigger_interest->wanted_pub == NULL)
+            ndn_retire_interest(h, trigger_interest);
     }
 
     namelen = (pco->offset[NDN_PCO_E_KeyName_Name] -
@@ -1611,26 +2573,30 @@ ndn_initiate_key_fetch(struct ndn *h,
     key_closure->p = &handle_key;
     key_closure->intdata = NDN_MAX_KEY_LINK_CHAIN; /* to limit how many links we will resolve */
 
-    key_name = ndn_charbuf_create();
+    key_name = ndn_charbuf_obtain(h, namelen);
     res = ndn_charbuf_append(key_name,
                              msg + pco->offset[NDN_PCO_B_KeyName_Name],
                              namelen);
-    templ = ndn_charbuf_create();
-    ndn_charbuf_append_tt(templ, NDN_DTAG_Interest, NDN_DTAG);
-    ndn_charbuf_append_tt(templ, NDN_DTAG_Name, NDN_DTAG);
-    ndn_charbuf_append_closer(templ); /* </Name> */
-    ndnb_tagged_putf(templ, NDN_DTAG_MinSuffixComponents, "%d", 1);
-    ndnb_tagged_putf(templ, NDN_DTAG_MaxSuffixComponents, "%d", 3);
     if (pco->offset[NDN_PCO_B_KeyName_Pub] < pco->offset[NDN_PCO_E_KeyName_Pub]) {
+        /* the publisher makes this one differ from the usual template */
+        templ = ndn_charbuf_obtain(h, 64);
+        ndn_charbuf_append_tt(templ, NDN_DTAG_Interest, NDN_DTAG);
+        ndn_charbuf_append_tt(templ, NDN_DTAG_Name, NDN_DTAG);
+        ndn_charbuf_append_closer(templ); /* </Name> */
+        ndnb_append_tagged_number(templ, NDN_DTAG_MinSuffixComponents, 1);
+        ndnb_append_tagged_number(templ, NDN_DTAG_MaxSuffixComponents, 3);
         ndn_charbuf_append(templ,
                            msg + pco->offset[NDN_PCO_B_KeyName_Pub],
                            (pco->offset[NDN_PCO_E_KeyName_Pub] -
                             pco->offset[NDN_PCO_B_KeyName_Pub]));
+        ndn_charbuf_append_closer(templ); /* </Interest> */
+        res = ndn_express_interest(h, key_name, key_closure, templ);
+        ndn_charbuf_destroy(&templ);
     }
-    ndn_charbuf_append_closer(templ); /* </Interest> */
-    res = ndn_express_interest(h, key_name, key_closure, templ);
+    else
+        res = express_interest(h, key_name, key_closure,
+                               ndn_key_fetch_template(h));
     ndn_charbuf_destroy(&key_name);
-    ndn_charbuf_destroy(&templ);
     return(res);
 }
 
@@ -1644,7 +2610,7 @@ ndn_check_pub_arrival(struct ndn *h, struct expressed_interest *interest)
     struct ndn_charbuf *want = interest->wanted_pub;
     if (want == NULL)
         return;
-    if (hashtb_lookup(h->keys, want->buf, want->length) != NULL) {
+    if (ndn_find_pkey(h, want->buf, want->length) != NULL) {
         ndn_charbuf_destroy(&interest->wanted_pub);
         interest->target = 1;
         ndn_refresh_interest(h, interest);
@@ -1652,159 +2618,500 @@ ndn_check_pub_arrival(struct ndn *h, struct expressed_interest *interest)
 }
 
 /**
- * 通过h的回调发送message。
- * 不是为常规client准备的，而是在ndnd需要和内部client通讯准备的。
- * 也就是说，ndnd将msg发送给内部client。
- * 参数： msg： ndnb编码过的interest或者data
- *
- * Dispatch a message through the registered upcalls.
- * This is not used by normal ndn clients, but is made available for use when
- * ndnd needs to communicate with its internal client.
- * @param h is the ndn handle.
- * @param msg is the ndnb-encoded Interest or ContentObject.
- * @param size is its size in bytes.
+ * Deliver an Interest to the matching interest filters.
+ * @returns -1 if msg does not parse as an Interest.
  */
-void
-ndn_dispatch_message(struct ndn *h, unsigned char *msg, size_t size)
+static int
+ndn_dispatch_interest(struct ndn *h, unsigned char *msg, size_t size,
+                      struct ndn_upcall_info *info)
 {
-    struct ndn_parsed_interest pi = {0};
-    struct ndn_upcall_info info = {0};
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct hashtb_enumerator ntee;
+    struct hashtb_enumerator *nte_e = &ntee;
+    struct name_tree_entry *autopath[NAME_TREE_AUTO_PATH];
+    struct name_tree_entry **path = autopath;
+    struct ndn_indexbuf *comps = info->interest_comps;
+    struct interest_filter *entry;
+    enum ndn_upcall_kind upcall_kind = NDN_UPCALL_INTEREST;
+    enum ndn_upcall_res ures;
     int i;
     int res;
-    enum ndn_upcall_res ures;
 
-    h->running++;
-    info.h = h;
-    info.pi = &pi;
-    info.interest_comps = ndn_indexbuf_obtain(h);
-    // 处理interest。返回代表此包是否是interest
-    res = ndn_parse_interest(msg, size, &pi, info.interest_comps);
-    // interest包
-    if (res >= 0) {
-        /* This message is an Interest */
-        enum ndn_upcall_kind upcall_kind = NDN_UPCALL_INTEREST;
-        info.interest_ndnb = msg;
-        if (h->interest_filters != NULL && info.interest_comps->n > 0) {
-            struct ndn_indexbuf *comps = info.interest_comps;
-            size_t keystart = comps->buf[0];
-            unsigned char *key = msg + keystart;
-            struct interest_filter *entry;
-            for (i = comps->n - 1; i >= 0; i--) {
-                entry = hashtb_lookup(h->interest_filters, key, comps->buf[i] - keystart);
-                if (entry != NULL) {
-                    info.matched_comps = i;
-                    ures = (entry->action->p)(entry->action, upcall_kind, &info);
-                    if (ures == NDN_UPCALL_RESULT_INTEREST_CONSUMED)
-                        upcall_kind = NDN_UPCALL_CONSUMED_INTEREST;
-                }
+    // 处理interest
+    res = ndn_parse_interest(msg, size, info->pi, comps);
+    if (res < 0)
+        return(-1);
+    info->interest_ndnb = msg;
+    if (h->interest_filters == NULL || comps->n == 0)
+        return(0);
+    if (comps->n > NAME_TREE_AUTO_PATH)
+        path = calloc(comps->n, sizeof(path[0]));
+    i = (path == NULL) ? -1 : name_tree_walk(h, msg, comps, path);
+    if (i >= 0) {
+        /* Keep what the upcalls unregister from being freed under us */
+        hashtb_start(h->name_tree, nte_e);
+        hashtb_start(h->interest_filters, e);
+        for (; i >= 0; i--) {
+            entry = path[i]->ifilt;
+            if (entry != NULL) {
+                info->matched_comps = i;
+                ures = (entry->action->p)(entry->action, upcall_kind, info);
+                if (ures == NDN_UPCALL_RESULT_INTEREST_CONSUMED)
+                    upcall_kind = NDN_UPCALL_CONSUMED_INTEREST;
             }
         }
+        hashtb_end(e);
+        hashtb_end(nte_e);
     }
-    // data包
-    else {
-        /* This message should be a ContentObject. */
-        struct ndn_parsed_ContentObject obj = {0};
-        info.pco = &obj;
-        info.content_comps = ndn_indexbuf_create();
-        // parse data
-        res = ndn_parse_ContentObject(msg, size, &obj, info.content_comps);
-        if (res >= 0) {
-            info.content_ndnb = msg;
-            if (h->interests_by_prefix != NULL) {
-                struct ndn_indexbuf *comps = info.content_comps;
-                size_t keystart = comps->buf[0];
-                unsigned char *key = msg + keystart;
-                struct expressed_interest *interest = NULL;
-                struct interests_by_prefix *entry = NULL;
-                for (i = comps->n - 1; i >= 0; i--) {
-                    entry = hashtb_lookup(h->interests_by_prefix, key, comps->buf[i] - keystart);
-                    if (entry != NULL) {
-                        for (interest = entry->list; interest != NULL; interest = interest->next) {
-                            if (interest->magic != 0x7059e5f4) {
-                                ndn_gripe(interest);
-                            }
-                            if (interest->target > 0 && interest->outstanding > 0) {
-                                res = ndn_parse_interest(interest->interest_msg,
-                                                         interest->size,
-                                                         info.pi,
-                                                         info.interest_comps);
-                                if (res >= 0 &&
-                                    ndn_content_matches_interest(msg, size,
-                                                                 1, info.pco,
-                                                                 interest->interest_msg,
-                                                                 interest->size,
-                                                                 info.pi)) {
-                                    enum ndn_upcall_kind upcall_kind = NDN_UPCALL_CONTENT;
-                                    struct ndn_pkey *pubkey = NULL;
-                                    int type = ndn_get_content_type(msg, info.pco);
-                                    if (type == NDN_CONTENT_KEY)
-                                        res = ndn_cache_key(h, msg, size, info.pco);
-                                    res = ndn_locate_key(h, msg, info.pco, &pubkey);
-                                    if (h->defer_verification) {
-                                        if (res == 0)
-                                            upcall_kind = NDN_UPCALL_CONTENT_RAW;
-                                        else
-                                            upcall_kind = NDN_UPCALL_CONTENT_KEYMISSING;
-                                    }
-                                    else if (res == 0) {
-                                        /* we have the pubkey, use it to verify the msg */
-                                        res = ndn_verify_signature(msg, size, info.pco, pubkey);
-                                        upcall_kind = (res == 1) ? NDN_UPCALL_CONTENT : NDN_UPCALL_CONTENT_BAD;
-                                    } else
-                                        upcall_kind = NDN_UPCALL_CONTENT_UNVERIFIED;
-                                    interest->outstanding -= 1;
-                                    info.interest_ndnb = interest->interest_msg;
-                                    info.matched_comps = i;
-                                    ures = (interest->action->p)(interest->action,
-                                                                 upcall_kind,
-                                                                 &info);
-                                    if (interest->magic != 0x7059e5f4)
-                                        ndn_gripe(interest);
-                                    if (ures == NDN_UPCALL_RESULT_REEXPRESS)
-                                        ndn_refresh_interest(h, interest);
-                                    else if ((ures == NDN_UPCALL_RESULT_VERIFY ||
-                                              ures == NDN_UPCALL_RESULT_FETCHKEY) &&
-                                             (upcall_kind == NDN_UPCALL_CONTENT_UNVERIFIED ||
-                                              upcall_kind == NDN_UPCALL_CONTENT_KEYMISSING)) { /* KEYS */
-                                        ndn_initiate_key_fetch(h, msg, info.pco, interest);
-                                    }
-                                    else if (ures == NDN_UPCALL_RESULT_VERIFY &&
-                                             upcall_kind == NDN_UPCALL_CONTENT_RAW) {
-                                        /* For now, call this a client bug. */
-                                        abort();
-                                    }
-                                    else {
-                                        interest->target = 0;
-                                        replace_interest_msg(interest, NULL);
-                                        ndn_replace_handler(h, &(interest->action), NULL);
-                                    }
-                                }
-                            }
-                        }
+    if (path != autopath)
+        free(path);
+    return(0);
+}
+
+/**
+ * Deliver a ContentObject to the outstanding interests that it satisfies.
+ * @param st is non-NULL if the content was streamed, in which case msg
+ *        has empty Content and st has the digest and verification result
+ *        for the real thing.
+ * @returns -1 if msg does not parse as a ContentObject.
+ */
+static int
+ndn_dispatch_content(struct ndn *h, unsigned char *msg, size_t size,
+                     struct ndn_upcall_info *info,
+                     const struct ndn_content_stream *st)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct hashtb_enumerator ntee;
+    struct hashtb_enumerator *nte_e = &ntee;
+    struct name_tree_entry *autopath[NAME_TREE_AUTO_PATH];
+    struct name_tree_entry **path = autopath;
+    struct ndn_parsed_interest *scratch_pi = info->pi;
+    struct ndn_indexbuf *scratch_comps = info->interest_comps;
+    struct ndn_indexbuf *comps;
+    struct expressed_interest *interest = NULL;
+    struct interests_by_prefix *entry = NULL;
+    enum ndn_upcall_res ures;
+    int depth;
+    int i;
+    int res;
+
+    // parse data; only the name, until some interest matches
+    info->content_comps = comps = ndn_indexbuf_obtain(h);
+    res = ndn_parse_ContentObject_lazy(msg, size, info->pco, comps);
+    if (res < 0)
+        return(-1);
+    if (st != NULL) {
+        memcpy(info->pco->digest, st->digest, sizeof(info->pco->digest));
+        info->pco->digest_bytes = sizeof(info->pco->digest);
+    }
+    info->content_ndnb = msg;
+    if (h->interests_by_prefix == NULL)
+        return(0);
+    if (comps->n > NAME_TREE_AUTO_PATH)
+        path = calloc(comps->n, sizeof(path[0]));
+    depth = (path == NULL) ? -1 : name_tree_walk(h, msg, comps, path);
+    if (depth >= 0) {
+        hashtb_start(h->name_tree, nte_e);
+        hashtb_start(h->interests_by_prefix, e);
+    }
+    for (i = depth; i >= 0; i--) {
+        entry = path[i]->ipfx;
+        if (entry == NULL)
+            continue;
+        for (interest = entry->list; interest != NULL; interest = interest->next) {
+            if (interest->magic != 0x7059e5f4) {
+                ndn_gripe(interest);
+            }
+            if (interest->target > 0 && interest->outstanding > 0 &&
+                interest->interest_msg != NULL) {
+                if (ndn_content_matches_interest(msg, size,
+                                                 1, info->pco,
+                                                 interest->interest_msg,
+                                                 interest->size,
+                                                 &interest->pi) &&
+                    ndn_parse_ContentObject_finish(msg, size, info->pco) >= 0) {
+                    enum ndn_upcall_kind upcall_kind = NDN_UPCALL_CONTENT;
+                    struct ndn_pkey *pubkey = NULL;
+                    int type = ndn_get_content_type(msg, info->pco);
+                    if (type == NDN_CONTENT_KEY)
+                        res = ndn_cache_key(h, msg, size, info->pco);
+                    res = ndn_locate_key(h, msg, info->pco, &pubkey);
+                    if (h->defer_verification) {
+                        if (res == 0)
+                            upcall_kind = NDN_UPCALL_CONTENT_RAW;
+                        else
+                            upcall_kind = NDN_UPCALL_CONTENT_KEYMISSING;
+                    }
+                    else if (res == 0) {
+                        /* we have the pubkey, use it to verify the msg */
+                        if (st != NULL)
+                            res = st->verified;
+                        else
+                            res = ndn_verify_signature(msg, size, info->pco, pubkey);
+                        upcall_kind = (res == 1) ? NDN_UPCALL_CONTENT : NDN_UPCALL_CONTENT_BAD;
+                    } else
+                        upcall_kind = NDN_UPCALL_CONTENT_UNVERIFIED;
+                    interest->outstanding -= 1;
+                    ndn_note_rtt(h, interest);
+                    info->interest_ndnb = interest->interest_msg;
+                    info->pi = &interest->pi;
+                    info->interest_comps = interest->comps;
+                    info->matched_comps = i;
+                    ures = (interest->action->p)(interest->action,
+                                                 upcall_kind,
+                                                 info);
+                    info->pi = scratch_pi;
+                    info->interest_comps = scratch_comps;
+                    if (interest->magic != 0x7059e5f4)
+                        ndn_gripe(interest);
+                    if (ures == NDN_UPCALL_RESULT_REEXPRESS)
+                        ndn_refresh_interest(h, interest);
+                    else if ((ures == NDN_UPCALL_RESULT_VERIFY ||
+                              ures == NDN_UPCALL_RESULT_FETCHKEY) &&
+                             (upcall_kind == NDN_UPCALL_CONTENT_UNVERIFIED ||
+                              upcall_kind == NDN_UPCALL_CONTENT_KEYMISSING)) { /* KEYS */
+                        ndn_initiate_key_fetch(h, msg, info->pco, interest);
                     }
+                    else if (ures == NDN_UPCALL_RESULT_VERIFY &&
+                             upcall_kind == NDN_UPCALL_CONTENT_RAW) {
+                        /* For now, call this a client bug. */
+                        abort();
+                    }
+                    else
+                        ndn_retire_interest(h, interest);
                 }
             }
         }
-    } // XXX whew, what a lot of right braces!
-    ndn_indexbuf_release(h, info.interest_comps);
-    ndn_indexbuf_destroy(&info.content_comps);
+    }
+    if (depth >= 0) {
+        hashtb_end(e);
+        hashtb_end(nte_e);
+    }
+    if (path != autopath)
+        free(path);
+    return(0);
+}
+
+/**
+ * Dispatch a message, which is the shell of a streamed ContentObject
+ * if st is non-NULL
+ */
+static void
+ndn_dispatch(struct ndn *h, unsigned char *msg, size_t size,
+             const struct ndn_content_stream *st)
+{
+    struct ndn_parsed_interest pi = {0};
+    struct ndn_parsed_ContentObject obj = {0};
+    struct ndn_upcall_info info = {0};
+    struct ndn_indexbuf *scratch_comps;
+
+    h->running++;
+    if (h->arena == NULL)
+        h->arena = ndn_arena_create(NDN_DISPATCH_ARENA_SIZE);
+    ndn_arena_enter(h->arena);
+    info.h = h;
+    info.pi = &pi;
+    info.interest_comps = scratch_comps = ndn_indexbuf_obtain(h);
+    switch (ndn_message_dtag(msg, size)) {
+        case NDN_DTAG_Interest:
+            ndn_dispatch_interest(h, msg, size, &info);
+            break;
+        case NDN_DTAG_ContentObject:
+            info.pco = &obj;
+            ndn_dispatch_content(h, msg, size, &info, st);
+            break;
+        case NDN_DTAG_StatusResponse:
+        default:
+            break;
+    }
+    ndn_indexbuf_release(h, scratch_comps);
+    ndn_indexbuf_release(h, info.content_comps);
+    ndn_arena_leave(h->arena);
     h->running--;
 }
 
+/**
+ * 通过h的回调发送message。
+ * 不是为常规client准备的，而是在ndnd需要和内部client通讯准备的。
+ * 也就是说，ndnd将msg发送给内部client。
+ * 参数： msg： ndnb编码过的interest或者data
+ *
+ * Dispatch a message through the registered upcalls.
+ * This is not used by normal ndn clients, but is made available for use when
+ * ndnd needs to communicate with its internal client.
+ *
+ * The outermost tag picks the handler, so each message is parsed once,
+ * by the right parser.  Other top-level types, such as StatusResponse,
+ * are recognized but have no upcalls, and are dropped.
+ * @param h is the ndn handle.
+ * @param msg is the ndnb-encoded Interest or ContentObject.
+ * @param size is its size in bytes.
+ */
+void
+ndn_dispatch_message(struct ndn *h, unsigned char *msg, size_t size)
+{
+    ndn_dispatch(h, msg, size, NULL);
+}
+
+/* * * streaming of large content * * */
+
+/*
+ * A ContentObject is streamed when a read leaves the decoder inside the
+ * BLOB of its Content, which is the only BLOB at nesting depth 2, with
+ * at least h->sink_min bytes of content in all.  What precedes the
+ * content becomes the shell, and is cut from the input buffer, as is
+ * each piece of content after it has been hashed and passed on, so the
+ * buffer stays small while the decoder carries on as though nothing
+ * had been taken.  By the time the decoder sees the end of the object,
+ * only the closers of Content and ContentObject are left.
+ */
+
+static void
+ndn_stream_destroy(struct ndn_content_stream **stp)
+{
+    struct ndn_content_stream *st = *stp;
+    if (st == NULL)
+        return;
+    ndn_charbuf_destroy(&st->shell);
+    ndn_indexbuf_destroy(&st->comps);
+    ndn_sigc_destroy(&st->verifier);
+    ndn_digest_destroy(&st->hash);
+    free(st);
+    *stp = NULL;
+}
+
+static int
+ndn_stream_tell(struct ndn *h, struct ndn_content_stream *st,
+                enum ndn_stream_kind kind,
+                const unsigned char *data, size_t size)
+{
+    struct ndn_stream_info info = {0};
+
+    info.h = h;
+    info.content_ndnb = st->shell->buf;
+    info.pco = &st->pco;
+    info.content_comps = st->comps;
+    info.content_size = st->content_size;
+    info.offset = st->offset;
+    info.data = data;
+    info.size = size;
+    info.verified = st->verified;
+    return((st->sink)(kind, &info, st->sink_data));
+}
+
+/**
+ * Remove n bytes of input at offset at, which the decoder has seen
+ */
+static void
+ndn_stream_cut(struct ndn *h, size_t at, size_t n)
+{
+    struct ndn_charbuf *inbuf = h->inbuf;
+
+    memmove(inbuf->buf + at, inbuf->buf + at + n, inbuf->length - at - n);
+    inbuf->length -= n;
+    h->decoder.index -= n;
+}
+
+/**
+ * Pass on the content that has been read
+ */
+static void
+ndn_stream_take(struct ndn *h, size_t msgstart)
+{
+    struct ndn_content_stream *st = h->stream;
+    const unsigned char *p = h->inbuf->buf + msgstart;
+    size_t n = h->decoder.index - msgstart;
+
+    if (n > st->content_size - st->offset)
+        n = st->content_size - st->offset;
+    if (n == 0)
+        return;
+    if (!st->failed) {
+        ndn_digest_update(st->hash, p, n);
+        if (st->verifier != NULL)
+            ndn_sigc_verify_update(st->verifier, p, n);
+        if (ndn_stream_tell(h, st, NDN_STREAM_DATA, p, n) < 0)
+            st->failed = 1;
+    }
+    st->offset += n;
+    ndn_stream_cut(h, msgstart, n);
+}
+
+/**
+ * See whether the partial message at msgstart should be streamed,
+ * and if so, start.
+ */
+static void
+ndn_stream_start(struct ndn *h, size_t msgstart)
+{
+    struct ndn_skeleton_decoder *d = &h->decoder;
+    unsigned char *msg = h->inbuf->buf + msgstart;
+    struct ndn_content_stream *st = NULL;
+    struct ndn_pkey *pubkey = NULL;
+    size_t b_name;
+    size_t start;
+    size_t i;
+    int type;
+
+    if (d->state != NDN_DSTATE_BLOB || d->nest != 2)
+        return;
+    if (ndn_message_dtag(msg, d->index - msgstart) != NDN_DTAG_ContentObject)
+        return;
+    /* the content starts after the BLOB header */
+    for (i = d->token_index; (h->inbuf->buf[i] & NDN_TT_HBIT) == 0; i++)
+        continue;
+    start = i + 1 - msgstart;
+    if (d->index - msgstart - start + d->numval < h->sink_min)
+        return;
+    h->stream = st = calloc(1, sizeof(*st));
+    if (st == NULL)
+        return;
+    st->declined = 1; /* until it is all set up */
+    st->sink = h->sink;
+    st->sink_data = h->sink_data;
+    st->verified = -1;
+    st->content_size = d->index - msgstart - start + d->numval;
+    st->shell = ndn_charbuf_create_n(d->token_index - msgstart + 2);
+    st->comps = ndn_indexbuf_create();
+    if (st->shell == NULL || st->comps == NULL)
+        goto Decline;
+    ndn_charbuf_append(st->shell, msg, d->token_index - msgstart);
+    ndn_charbuf_append_closer(st->shell); /* </Content> */
+    ndn_charbuf_append_closer(st->shell); /* </ContentObject> */
+    if (ndn_parse_ContentObject(st->shell->buf, st->shell->length,
+                                &st->pco, st->comps) < 0)
+        goto Decline;
+    /* these are needed whole */
+    type = ndn_get_content_type(st->shell->buf, &st->pco);
+    if (type == NDN_CONTENT_KEY || type == NDN_CONTENT_LINK)
+        goto Decline;
+    if (!h->defer_verification) {
+        /* Without the key, let the usual path go and fetch it */
+        if (ndn_locate_key(h, st->shell->buf, &st->pco, &pubkey) != 0)
+            goto Decline;
+        b_name = st->pco.offset[NDN_PCO_B_Name];
+        st->verifier = ndn_sigc_create();
+        if (st->verifier == NULL ||
+            ndn_sigc_verify_init(st->verifier, st->shell->buf,
+                                 &st->pco, pubkey) < 0 ||
+            ndn_sigc_verify_update(st->verifier, msg + b_name,
+                                   start - b_name) < 0)
+            goto Decline;
+    }
+    st->hash = ndn_digest_create(NDN_DIGEST_SHA256);
+    if (st->hash == NULL)
+        goto Decline;
+    ndn_digest_init(st->hash);
+    ndn_digest_update(st->hash, msg, start);
+    if (ndn_stream_tell(h, st, NDN_STREAM_HEAD, NULL, 0) < 0)
+        goto Decline;
+    st->declined = 0;
+    ndn_stream_cut(h, msgstart, start);
+    ndn_stream_take(h, msgstart);
+    return;
+Decline:
+    /* keep the record, so as not to look again at every read */
+    ndn_charbuf_destroy(&st->shell);
+    ndn_indexbuf_destroy(&st->comps);
+    ndn_sigc_destroy(&st->verifier);
+    ndn_digest_destroy(&st->hash);
+}
+
+/**
+ * The decoder has reached the end of the streamed object; msg holds
+ * what followed the content.
+ */
+static void
+ndn_stream_finish(struct ndn *h, const unsigned char *msg, size_t size)
+{
+    struct ndn_content_stream *st = h->stream;
+    struct ndn_pkey *pubkey = NULL;
+
+    h->stream = NULL;
+    if (st->failed || st->offset != st->content_size ||
+        size != 2 || msg[0] != 0 || msg[1] != 0) {
+        ndn_stream_tell(h, st, NDN_STREAM_ABORTED, NULL, 0);
+        ndn_stream_destroy(&st);
+        return;
+    }
+    ndn_digest_update(st->hash, msg, size);
+    ndn_digest_final(st->hash, st->digest, sizeof(st->digest));
+    if (st->verifier != NULL) {
+        /* the signed part ends with </Content> */
+        st->verified = 0;
+        if (ndn_sigc_verify_update(st->verifier, msg, 1) == 0 &&
+            ndn_locate_key(h, st->shell->buf, &st->pco, &pubkey) == 0 &&
+            ndn_sigc_verify_final(st->verifier, st->shell->buf,
+                                  &st->pco, pubkey) == 1)
+            st->verified = 1;
+    }
+    ndn_stream_tell(h, st, NDN_STREAM_END, NULL, 0);
+    ndn_dispatch(h, st->shell->buf, st->shell->length, st);
+    ndn_stream_destroy(&st);
+}
+
+/**
+ * Give up on the object being streamed, as when the connection is lost
+ */
+static void
+ndn_stream_abort(struct ndn *h)
+{
+    struct ndn_content_stream *st = h->stream;
+
+    if (st == NULL)
+        return;
+    h->stream = NULL;
+    if (!st->declined)
+        ndn_stream_tell(h, st, NDN_STREAM_ABORTED, NULL, 0);
+    ndn_stream_destroy(&st);
+}
+
+/**
+ * Read what is available from h->sock and dispatch any complete messages
+ *
+ * Messages are dispatched in place.  A partial message at the end is left
+ * where it is, with h->inbufindex marking its start, and is only moved
+ * to the front of the buffer when there is no longer room after it for a
+ * full-sized read.  If a content sink is set, the content of a large
+ * ContentObject is passed to it as it arrives instead of being kept.
+ * @returns 1 if something was read, 0 if nothing was available,
+ *          or -1 for error or end of file.
+ */
 static int
 ndn_process_input(struct ndn *h)
 {
     ssize_t res;
-    ssize_t msgstart;
+    size_t msgstart;
+    size_t room;
     unsigned char *buf;
     struct ndn_skeleton_decoder *d = &h->decoder;
     struct ndn_charbuf *inbuf = h->inbuf;
     if (inbuf == NULL)
         h->inbuf = inbuf = ndn_charbuf_create();
-    if (inbuf->length == 0)
+    if (inbuf == NULL)
+        return(NOTE_ERRNO(h));
+    if (inbuf->length == 0 && h->stream == NULL) {
         memset(d, 0, sizeof(*d));
-    // 将inbuf扩展8800字节
-    buf = ndn_charbuf_reserve(inbuf, 8800);
+        h->inbufindex = 0;
+    }
+    room = h->inbuf_size / 2;
+    if (inbuf->limit - inbuf->length < room && h->inbufindex > 0) {
+        /* move partial message to start of buffer */
+        memmove(inbuf->buf, inbuf->buf + h->inbufindex,
+                inbuf->length - h->inbufindex);
+        inbuf->length -= h->inbufindex;
+        d->index -= h->inbufindex;
+        d->token_index -= h->inbufindex;
+        d->element_index -= h->inbufindex;
+        h->inbufindex = 0;
+    }
+    if (inbuf->length + room < h->inbuf_size)
+        room = h->inbuf_size - inbuf->length;
+    buf = ndn_charbuf_reserve(inbuf, room);
+    if (buf == NULL)
+        return(NOTE_ERRNO(h));
     // 读 socket
     res = read(h->sock, buf, inbuf->limit - inbuf->length);
     if (res == 0) {
@@ -1813,66 +3120,288 @@ ndn_process_input(struct ndn *h)
     }
     if (res == -1) {
         if (errno == EAGAIN)
-            res = 0;
-        else
-            return(NOTE_ERRNO(h));
+            return(0);
+        return(NOTE_ERRNO(h));
     }
     inbuf->length += res;
-    msgstart = 0;
+    msgstart = h->inbufindex;
+    h->running++; /* hold output from the upcalls, to send it all at once */
     // buf中是数据。解码数据。
     ndn_skeleton_decode(d, buf, res);
-    while (d->state == 0) {
-        ndn_dispatch_message(h, inbuf->buf + msgstart,
-                              d->index - msgstart);
+    for (;;) {
+        if (h->stream == NULL) {
+            if (h->sink != NULL && d->state != 0)
+                ndn_stream_start(h, msgstart);
+        }
+        else if (!h->stream->declined)
+            ndn_stream_take(h, msgstart);
+        if (d->state != 0)
+            break;
+        if (h->stream != NULL && !h->stream->declined)
+            ndn_stream_finish(h, inbuf->buf + msgstart, d->index - msgstart);
+        else {
+            ndn_stream_destroy(&h->stream);
+            ndn_dispatch_message(h, inbuf->buf + msgstart,
+                                  d->index - msgstart);
+        }
         msgstart = d->index;
         if (msgstart == inbuf->length) {
-            inbuf->length = 0;
-            return(0);
+            msgstart = inbuf->length = 0;
+            break;
         }
         ndn_skeleton_decode(d, inbuf->buf + d->index,
                             inbuf->length - d->index);
     }
-    if (msgstart < inbuf->length && msgstart > 0) {
-        /* move partial message to start of buffer */
-        memmove(inbuf->buf, inbuf->buf + msgstart,
-                inbuf->length - msgstart);
-        inbuf->length -= msgstart;
-        d->index -= msgstart;
-    }
-    return(0);
+    h->inbufindex = msgstart;
+    h->running--;
+    if (ndn_output_is_pending(h))
+        ndn_pushout(h);
+    return(1);
 }
 
-static void
-ndn_update_refresh_us(struct ndn *h, struct timeval *tv)
+/**
+ * Microseconds from h->now until tv, but no more than the idle refresh time
+ */
+static int
+ndn_micros_until(struct ndn *h, const struct timeval *tv)
 {
+    int max = 5 * NDN_INTEREST_LIFETIME_MICROSEC;
     int delta;
     if (tv->tv_sec < h->now.tv_sec)
-        return;
-    if (tv->tv_sec > h->now.tv_sec + NDN_INTEREST_LIFETIME_SEC)
-        return;
+        return(0);
+    if (tv->tv_sec > h->now.tv_sec + 5 * NDN_INTEREST_LIFETIME_SEC)
+        return(max);
     delta = (tv->tv_sec  - h->now.tv_sec)*1000000 +
             (tv->tv_usec - h->now.tv_usec);
     if (delta < 0)
         delta = 0;
-    if (delta < h->refresh_us)
-        h->refresh_us = delta;
+    if (delta > max)
+        delta = max;
+    return(delta);
 }
 
+/* * * round-trip estimation * * */
+
+/*
+ * Each interest is retransmitted, with the same message, whenever its
+ * retransmission timeout passes without an answer; the timeout doubles
+ * with each retry.  This is independent of the interest lifetime, which
+ * still decides when the client gets NDN_UPCALL_INTEREST_TIMED_OUT.
+ * The timeout comes from smoothed round-trip estimates (Jacobson/Karels)
+ * kept per parent prefix of the interest name, so that, e.g., all the
+ * segments of a stream share one.  Samples are not taken from interests
+ * that have been retransmitted, since it is not known which
+ * transmission was answered.
+ */
+
+/**
+ * Find or make the round-trip estimate for the prefix of an interest name
+ * that leaves off its last component.
+ *
+ * Falls back to the handle-wide estimate when the table is full.
+ */
+static struct ndn_rtt_stats *
+ndn_rtt_for_interest(struct ndn *h, struct expressed_interest *ie)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ndn_rtt_stats *rtt;
+    struct ndn_indexbuf *comps = ie->comps;
+    const unsigned char *key;
+    size_t keysize;
+    int res;
+
+    if (comps == NULL || comps->n < 1 || ie->interest_msg == NULL)
+        return(&h->rtt);
+    key = ie->interest_msg + comps->buf[0];
+    keysize = comps->buf[comps->n < 2 ? 0 : comps->n - 2] - comps->buf[0];
+    if (h->rtt_by_prefix == NULL) {
+        struct hashtb_param param = {0};
+        h->rtt_by_prefix = hashtb_create_flags(sizeof(struct ndn_rtt_stats),
+                                               &param, NDN_FAST_TABLE_FLAGS);
+        if (h->rtt_by_prefix == NULL)
+            return(&h->rtt);
+    }
+    rtt = hashtb_lookup(h->rtt_by_prefix, key, keysize);
+    if (rtt != NULL)
+        return(rtt);
+    if (hashtb_n(h->rtt_by_prefix) >= NDN_RTT_MAX_PREFIXES)
+        return(&h->rtt);
+    hashtb_start(h->rtt_by_prefix, e);
+    res = hashtb_seek(e, key, keysize, 0);
+    rtt = e->data;
+    if (rtt != NULL && res == HT_NEW_ENTRY) {
+        /* start from what is known for the handle as a whole */
+        rtt->srtt_us = h->rtt.srtt_us;
+        rtt->rttvar_us = h->rtt.rttvar_us;
+        rtt->rto_us = h->rtt.rto_us;
+    }
+    hashtb_end(e);
+    return(rtt != NULL ? rtt : &h->rtt);
+}
+
+static void
+ndn_rtt_update(struct ndn_rtt_stats *rtt, int sample)
+{
+    int err;
+    int rto;
+
+    if (rtt->samples++ == 0) {
+        rtt->srtt_us = sample;
+        rtt->rttvar_us = sample / 2;
+    }
+    else {
+        err = sample - rtt->srtt_us;
+        rtt->srtt_us += err / 8;
+        if (err < 0)
+            err = -err;
+        rtt->rttvar_us += (err - rtt->rttvar_us) / 4;
+    }
+    rto = rtt->srtt_us + 4 * rtt->rttvar_us;
+    if (rto < NDN_RTO_MIN_MICROSEC)
+        rto = NDN_RTO_MIN_MICROSEC;
+    if (rto > NDN_INTEREST_LIFETIME_MICROSEC)
+        rto = NDN_INTEREST_LIFETIME_MICROSEC;
+    rtt->rto_us = rto;
+}
+
+/**
+ * Take a round-trip sample from an interest that has just been answered
+ */
 static void
+ndn_note_rtt(struct ndn *h, struct expressed_interest *ie)
+{
+    struct timeval now;
+    int sample;
+
+    if (ie->retries != 0 || ie->senttime.tv_sec == 0)
+        return;
+    gettimeofday(&now, NULL);
+    if (now.tv_sec - ie->senttime.tv_sec > 30)
+        return;
+    sample = (now.tv_sec  - ie->senttime.tv_sec) * 1000000 +
+             (now.tv_usec - ie->senttime.tv_usec);
+    ie->senttime.tv_sec = 0; /* one sample per transmission */
+    if (sample < 0)
+        return;
+    if (ie->rtt != NULL && ie->rtt != &h->rtt)
+        ndn_rtt_update(ie->rtt, sample);
+    ndn_rtt_update(&h->rtt, sample);
+}
+
+/**
+ * Current retransmission timeout for an interest, with backoff
+ * @returns microseconds, or the lifetime if not retransmitting.
+ */
+static int
+ndn_interest_rto(struct ndn *h, struct expressed_interest *ie)
+{
+    struct ndn_rtt_stats *rtt = (ie->rtt != NULL) ? ie->rtt : &h->rtt;
+    int rto = rtt->rto_us;
+    int i;
+
+    if (!h->retransmit || !ie->retransmit || rto <= 0)
+        return(ie->lifetime_us);
+    for (i = 0; i < ie->retries && rto < ie->lifetime_us; i++)
+        rto *= 2;
+    if (rto > ie->lifetime_us)
+        rto = ie->lifetime_us;
+    return(rto);
+}
+
+/**
+ * Send an outstanding interest again if its RTO has passed
+ * @returns microseconds until it should be looked at again.
+ */
+static int
+ndn_retransmit_interest(struct ndn *h, struct expressed_interest *ie)
+{
+    int rto = ndn_interest_rto(h, ie);
+    int since;
+
+    if (ie->senttime.tv_sec == 0 ||
+        h->now.tv_sec - ie->senttime.tv_sec > 30)
+        since = rto;
+    else
+        since = (h->now.tv_sec  - ie->senttime.tv_sec) * 1000000 +
+                (h->now.tv_usec - ie->senttime.tv_usec);
+    if (since < rto)
+        return(rto - since);
+    if (ndn_put(h, ie->interest_msg, ie->size) < 0)
+        return(rto);
+    ie->senttime = h->now;
+    ie->retries++;
+    if (ie->rtt != NULL && ie->rtt != &h->rtt)
+        ie->rtt->retransmits++;
+    h->rtt.retransmits++;
+    return(ndn_interest_rto(h, ie));
+}
+
+/**
+ * Turn retransmission of interests on the RTO on or off
+ *
+ * It is on by default.  When off, interests are only sent again when
+ * their lifetime runs out and the client asks for that.  Interests
+ * expressed while it is off stay that way, so a caller that runs its
+ * own retransmission timer may turn it off just around its calls to
+ * ndn_express_interest.
+ * @returns the previous setting.
+ */
+int
+ndn_set_interest_retransmit(struct ndn *h, int enabled)
+{
+    int old = h->retransmit;
+    h->retransmit = (enabled != 0);
+    return(old);
+}
+
+/**
+ * Get the round-trip estimate and retransmission counters
+ *
+ * @param h is the ndn handle.
+ * @param prefix is an ndnb-encoded Name.  Estimates are kept for the
+ *        prefixes formed by leaving the last component off the names of
+ *        expressed interests.  NULL asks for the totals for the handle.
+ * @param stats is filled in.
+ * @returns 0, or -1 if nothing is known about the prefix.
+ */
+int
+ndn_get_rtt_stats(struct ndn *h,
+                  const struct ndn_charbuf *prefix,
+                  struct ndn_rtt_stats *stats)
+{
+    struct ndn_rtt_stats *rtt = NULL;
+
+    if (prefix == NULL)
+        rtt = &h->rtt;
+    else if (h->rtt_by_prefix != NULL && prefix->length >= 2)
+        rtt = hashtb_lookup(h->rtt_by_prefix, prefix->buf + 1,
+                            prefix->length - 2);
+    if (rtt == NULL)
+        return(-1);
+    *stats = *rtt;
+    return(0);
+}
+
+/* end of round-trip estimation */
+
+/**
+ * Check an interest for expiry, calling the timeout upcall as needed
+ * @returns the number of microseconds until the interest will need
+ *          attention again.
+ */
+static int
 ndn_age_interest(struct ndn *h,
-                 struct expressed_interest *interest,
-                 const unsigned char *key, size_t keysize)
+                 struct expressed_interest *interest)
 {
-    struct ndn_parsed_interest pi = {0};
     struct ndn_upcall_info info = {0};
     int delta;
-    int res;
+    int ans;
     enum ndn_upcall_res ures;
     int firstcall;
     if (interest->magic != 0x7059e5f4)
         ndn_gripe(interest);
     info.h = h;
-    info.pi = &pi;
     firstcall = (interest->lasttime.tv_sec == 0);
     if (interest->lasttime.tv_sec + 30 < h->now.tv_sec) {
         /* fixup so that delta does not overflow */
@@ -1883,13 +3412,17 @@ ndn_age_interest(struct ndn *h,
     delta = (h->now.tv_sec  - interest->lasttime.tv_sec)*1000000 +
             (h->now.tv_usec - interest->lasttime.tv_usec);
     if (delta >= interest->lifetime_us) {
+        if (interest->outstanding > 0 && !firstcall) {
+            if (interest->rtt != NULL && interest->rtt != &h->rtt)
+                interest->rtt->timeouts++;
+            h->rtt.timeouts++;
+        }
         interest->outstanding = 0;
         delta = 0;
     }
     else if (delta < 0)
         delta = 0;
-    if (interest->lifetime_us - delta < h->refresh_us)
-        h->refresh_us = interest->lifetime_us - delta;
+    ans = interest->lifetime_us - delta;
     interest->lasttime = h->now;
     while (delta > interest->lasttime.tv_usec) {
         delta -= 1000000;
@@ -1900,12 +3433,9 @@ ndn_age_interest(struct ndn *h,
         ures = NDN_UPCALL_RESULT_REEXPRESS;
         if (!firstcall) {
             info.interest_ndnb = interest->interest_msg;
-            info.interest_comps = ndn_indexbuf_obtain(h);
-            res = ndn_parse_interest(interest->interest_msg,
-                                     interest->size,
-                                     info.pi,
-                                     info.interest_comps);
-            if (res >= 0) {
+            info.pi = &interest->pi;
+            info.interest_comps = interest->comps;
+            if (interest->interest_msg != NULL) {
                 ures = (interest->action->p)(interest->action,
                                              NDN_UPCALL_INTEREST_TIMED_OUT,
                                              &info);
@@ -1919,32 +3449,241 @@ ndn_age_interest(struct ndn *h,
                     sleep(1);
                 ures = NDN_UPCALL_RESULT_ERR;
             }
-            ndn_indexbuf_release(h, info.interest_comps);
         }
         if (ures == NDN_UPCALL_RESULT_REEXPRESS)
             ndn_refresh_interest(h, interest);
         else
             interest->target = 0;
     }
+    else if (interest->target > 0 && h->retransmit &&
+             interest->retransmit) {
+        delta = ndn_retransmit_interest(h, interest);
+        if (delta < ans)
+            ans = delta;
+    }
+    return(ans);
+}
+
+/* * * timers * * */
+
+/*
+ * Expiry of pending interests and of prefix registrations is driven by
+ * events in h->interest_sched, so that ndn_process_scheduled_operations
+ * only does work for the things that are actually due.  Each interest
+ * and each filter has at most one pending event; it is not disturbed
+ * when content arrives or a registration is renewed, but instead checks
+ * the current state when it fires and arms a new event as needed.
+ */
+
+static void
+ndn_client_gettime(const struct ndn_gettime *self, struct ndn_timeval *result)
+{
+    struct timeval now = {0};
+    gettimeofday(&now, 0);
+    result->s = now.tv_sec;
+    result->micros = now.tv_usec;
+}
+
+static const struct ndn_gettime ndn_client_ticker = {
+    "timer", &ndn_client_gettime, 1000000, NULL
+};
+
+static struct ndn_schedule *
+ndn_timer_sched(struct ndn *h)
+{
+    if (h->interest_sched == NULL) {
+        h->interest_sched = ndn_schedule_create(h, &ndn_client_ticker);
+        if (h->interest_sched == NULL)
+            NOTE_ERRNO(h);
+    }
+    return(h->interest_sched);
+}
+
+static void
+ndn_cancel_timer(struct ndn *h, struct ndn_scheduled_event **evp)
+{
+    if (*evp != NULL) {
+        ndn_schedule_cancel(h->interest_sched, *evp);
+        *evp = NULL;
+    }
+}
+
+/**
+ * Scheduled action for the expiry of an expressed interest
+ */
+static int
+ndn_interest_timer(struct ndn_schedule *sched,
+                   void *clienth,
+                   struct ndn_scheduled_event *ev,
+                   int flags)
+{
+    struct ndn *h = clienth;
+    struct expressed_interest *ie = ev->evdata;
+    int micros;
+
+    if ((flags & NDN_SCHEDULE_CANCEL) != 0)
+        return(0);
+    if (ie->magic != 0x7059e5f4) {
+        ndn_gripe(ie);
+        return(0);
+    }
+    ie->ev = NULL;
+    gettimeofday(&h->now, NULL);
+    if (ie->target != 0) {
+        micros = ndn_age_interest(h, ie);
+        if (ie->target != 0)
+            ndn_arm_interest_timer(h, ie, micros);
+    }
+    if (ie->target == 0 && ie->wanted_pub == NULL)
+        ndn_retire_interest(h, ie);
+    return(0);
+}
+
+/**
+ * Arrange for the interest to be checked after the given delay,
+ * unless a check is already pending.
+ */
+static void
+ndn_arm_interest_timer(struct ndn *h, struct expressed_interest *ie, int micros)
+{
+    struct ndn_schedule *sched;
+    if (ie->ev != NULL)
+        return;
+    sched = ndn_timer_sched(h);
+    if (sched == NULL)
+        return;
+    ie->ev = ndn_schedule_event(sched, micros, &ndn_interest_timer, ie, 0);
+}
+
+/**
+ * Scheduled action for the expiry of a prefix registration
+ */
+static int
+ndn_ifilt_timer(struct ndn_schedule *sched,
+                void *clienth,
+                struct ndn_scheduled_event *ev,
+                int flags)
+{
+    struct ndn *h = clienth;
+    struct interest_filter *i = ev->evdata;
+
+    if ((flags & NDN_SCHEDULE_CANCEL) != 0)
+        return(0);
+    i->ev = NULL;
+    gettimeofday(&h->now, NULL);
+    if (!tv_earlier(&h->now, &i->expiry)) {
+        /* registration is expiring, refresh it */
+        ndn_initiate_prefix_reg(h, i->key, i->keysize, i);
+    }
+    if (i->ev == NULL)
+        ndn_arm_ifilt_timer(h, i);
+    return(0);
+}
+
+/**
+ * (Re)arm the refresh of a prefix registration to match its expiry time.
+ */
+static void
+ndn_arm_ifilt_timer(struct ndn *h, struct interest_filter *i)
+{
+    struct ndn_schedule *sched;
+    sched = ndn_timer_sched(h);
+    if (sched == NULL)
+        return;
+    ndn_cancel_timer(h, &i->ev);
+    if (h->now.tv_sec == 0)
+        gettimeofday(&h->now, NULL);
+    i->ev = ndn_schedule_event(sched, ndn_micros_until(h, &i->expiry),
+                               &ndn_ifilt_timer, i, 0);
+}
+
+/**
+ * Put the entry on the list to be looked at by ndn_clean_dirty_prefixes.
+ */
+static void
+ndn_note_dirty_prefix(struct ndn *h, struct interests_by_prefix *entry)
+{
+    if (entry == NULL || entry->dirty)
+        return;
+    entry->dirty = 1;
+    entry->next_dirty = h->dirty_prefixes;
+    h->dirty_prefixes = entry;
+}
+
+/**
+ * Give up on an interest that is no longer wanted.
+ *
+ * The storage is reclaimed on the next call to
+ * ndn_process_scheduled_operations.
+ */
+static void
+ndn_retire_interest(struct ndn *h, struct expressed_interest *ie)
+{
+    ie->target = 0;
+    replace_interest_msg(h, ie, NULL);
+    ndn_replace_handler(h, &(ie->action), NULL);
+    ndn_note_dirty_prefix(h, ie->owner);
 }
 
+/**
+ * Reclaim retired interests, and any prefix entries left empty.
+ */
 static void
-ndn_clean_all_interests(struct ndn *h)
+ndn_clean_dirty_prefixes(struct ndn *h)
 {
     struct hashtb_enumerator ee;
     struct hashtb_enumerator *e = &ee;
     struct interests_by_prefix *entry;
-    for (hashtb_start(h->interests_by_prefix, e); e->data != NULL;) {
-        entry = e->data;
+
+    hashtb_start(h->interests_by_prefix, e);
+    while ((entry = h->dirty_prefixes) != NULL) {
+        h->dirty_prefixes = entry->next_dirty;
+        entry->next_dirty = NULL;
+        entry->dirty = 0;
         ndn_clean_interests_by_prefix(h, entry);
-        if (entry->list == NULL)
-            hashtb_delete(e);
-        else
-            hashtb_next(e);
+        if (entry->list == NULL) {
+            if (entry->nte != NULL) {
+                entry->nte->ipfx = NULL;
+                name_tree_release(h, entry->nte);
+                entry->nte = NULL;
+            }
+            if (hashtb_seek(e, entry->key, entry->keysize, 0) >= 0)
+                hashtb_delete(e);
+        }
     }
     hashtb_end(e);
 }
 
+/**
+ * Re-express any interests whose awaited keys have arrived.
+ *
+ * The waiters are only looked at when the number of known keys changes.
+ */
+static void
+ndn_check_pub_waiters(struct ndn *h)
+{
+    struct expressed_interest **pp;
+    struct expressed_interest *ie;
+    int n = hashtb_n(h->keys);
+
+    if (h->key_cache != NULL)
+        n += hashtb_shared_n(h->key_cache);
+    if (n == h->keys_seen)
+        return;
+    h->keys_seen = n;
+    for (pp = &h->pub_waiters; (ie = *pp) != NULL;) {
+        ndn_check_pub_arrival(h, ie);
+        if (ie->wanted_pub == NULL) {
+            *pp = ie->next_waiter;
+            ie->next_waiter = NULL;
+        }
+        else
+            pp = &ie->next_waiter;
+    }
+}
+
+/* end of timers */
+
 static void
 ndn_notify_ndndid_changed(struct ndn *h)
 {
@@ -1956,6 +3695,7 @@ ndn_notify_ndndid_changed(struct ndn *h)
             if ((i->flags & NDN_FORW_WAITING_NDNDID) != 0) {
                 i->expiry = h->now;
                 i->flags &= ~NDN_FORW_WAITING_NDNDID;
+                ndn_arm_ifilt_timer(h, i);
             }
         }
         hashtb_end(e);
@@ -2001,52 +3741,24 @@ ndn_set_schedule(struct ndn *h, struct ndn_schedule *schedule)
 int
 ndn_process_scheduled_operations(struct ndn *h)
 {
-    struct hashtb_enumerator ee;
-    struct hashtb_enumerator *e = &ee;
-    struct interests_by_prefix *entry;
-    struct expressed_interest *ie;
-    int need_clean = 0;
+    int usec;
     h->refresh_us = 5 * NDN_INTEREST_LIFETIME_MICROSEC;
     gettimeofday(&h->now, NULL);
     if (ndn_output_is_pending(h))
         return(h->refresh_us);
     h->running++;
-    if (h->interest_filters != NULL) {
-        for (hashtb_start(h->interest_filters, e); e->data != NULL; hashtb_next(e)) {
-            struct interest_filter *i = e->data;
-            if (tv_earlier(&i->expiry, &h->now)) {
-                /* registration is expiring, refresh it */
-                ndn_initiate_prefix_reg(h, e->key, e->keysize, i);
-            }
-            else
-                ndn_update_refresh_us(h, &i->expiry);
-        }
-        hashtb_end(e);
-    }
-    if (h->interests_by_prefix != NULL) {
-        for (hashtb_start(h->interests_by_prefix, e); e->data != NULL; hashtb_next(e)) {
-            entry = e->data;
-            ndn_check_interests(entry->list);
-            if (entry->list == NULL)
-                need_clean = 1;
-            else {
-                for (ie = entry->list; ie != NULL; ie = ie->next) {
-                    ndn_check_pub_arrival(h, ie);
-                    if (ie->target != 0)
-                        ndn_age_interest(h, ie, e->key, e->keysize);
-                    if (ie->target == 0 && ie->wanted_pub == NULL) {
-                        ndn_replace_handler(h, &(ie->action), NULL);
-                        replace_interest_msg(ie, NULL);
-                        need_clean = 1;
-                    }
-                }
-            }
-        }
-        hashtb_end(e);
-        if (need_clean)
-            ndn_clean_all_interests(h);
+    if (h->pub_waiters != NULL)
+        ndn_check_pub_waiters(h);
+    if (h->interest_sched != NULL) {
+        usec = ndn_schedule_run(h->interest_sched);
+        if (usec >= 0 && usec < h->refresh_us)
+            h->refresh_us = usec;
     }
+    if (h->dirty_prefixes != NULL)
+        ndn_clean_dirty_prefixes(h);
     h->running--;
+    if (ndn_output_is_pending(h))
+        ndn_pushout(h);
     return(h->refresh_us);
 }
 
@@ -2116,40 +3828,417 @@ ndn_run(struct ndn *h, int timeout)
                 break;
             }
         }
-        // 轮训的目标是h的sock
-        fds[0].fd = h->sock;
-        fds[0].events = POLLIN;
-        if (ndn_output_is_pending(h))
-            fds[0].events |= POLLOUT;
-        millisec = microsec / 1000;
-        if (timeout >= 0 && timeout < millisec)
-            millisec = timeout;
-        res = poll(fds, 1, millisec);
-        if (res < 0 && errno != EINTR) {
-            res = NOTE_ERRNO(h);
+        // 轮训的目标是h的sock
+        fds[0].fd = h->sock;
+        fds[0].events = POLLIN;
+        if (ndn_output_is_pending(h))
+            fds[0].events |= POLLOUT;
+        millisec = microsec / 1000;
+        if (timeout >= 0 && timeout < millisec)
+            millisec = timeout;
+        res = poll(fds, 1, millisec);
+        if (res < 0 && errno != EINTR) {
+            res = NOTE_ERRNO(h);
+            break;
+        }
+        if (res > 0) {
+            if ((fds[0].revents | POLLOUT) != 0)
+                // puts("writing");
+                // 有东西要写
+                ndn_pushout(h);
+            if ((fds[0].revents | POLLIN) != 0)
+                // 有东西要读
+                // puts("reading");
+                ndn_process_input(h);
+        }
+        if (h->err == ENOTCONN)
+            // 记得关掉连接
+            ndn_disconnect(h);
+        if (h->timeout == 0)
+            break;
+    }
+    if (h->running != 0)
+        abort();
+    return((res < 0) ? res : 0);
+}
+
+#ifdef __linux__
+/* * * ndn_loop * * */
+
+/**
+ * One registration in a ndn_loop - either a handle or an application fd
+ */
+struct ndn_loop_item {
+    struct ndn *h;              /* the handle, or NULL for an app fd */
+    int fd;                     /* fd currently registered, or -1 */
+    unsigned connects;          /* h->connects when fd was registered */
+    ndn_loop_fd_action action;  /* for app fds */
+    void *data;                 /* for app fds */
+    int dead;                   /* removed, free at next sweep */
+    struct ndn_loop_item *next;
+};
+
+/**
+ * Event loop serving many handles and application fds from one thread
+ */
+struct ndn_loop {
+    int epfd;
+    int running;
+    int timeout;
+    int ndead;
+    struct ndn_loop_item *items;
+};
+
+#define NDN_LOOP_MAX_EVENTS 64
+
+/**
+ * Create an event loop for running several handles with ndn_run_many.
+ * On error, returns NULL and sets errno.
+ */
+struct ndn_loop *
+ndn_loop_create(void)
+{
+    struct ndn_loop *loop;
+    loop = calloc(1, sizeof(*loop));
+    if (loop == NULL)
+        return(NULL);
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd == -1) {
+        free(loop);
+        return(NULL);
+    }
+    loop->timeout = -1;
+    return(loop);
+}
+
+static void
+ndn_loop_sweep(struct ndn_loop *loop)
+{
+    struct ndn_loop_item **pp;
+    struct ndn_loop_item *item;
+    for (pp = &loop->items; (item = *pp) != NULL;) {
+        if (item->dead) {
+            *pp = item->next;
+            free(item);
+        }
+        else
+            pp = &item->next;
+    }
+    loop->ndead = 0;
+}
+
+/**
+ * Destroy an event loop
+ *
+ * The handles and fds that were registered are not closed.
+ */
+void
+ndn_loop_destroy(struct ndn_loop **loopp)
+{
+    struct ndn_loop *loop = *loopp;
+    struct ndn_loop_item *item;
+    if (loop == NULL)
+        return;
+    while ((item = loop->items) != NULL) {
+        loop->items = item->next;
+        free(item);
+    }
+    close(loop->epfd);
+    free(loop);
+    *loopp = NULL;
+}
+
+static struct ndn_loop_item *
+ndn_loop_new_item(struct ndn_loop *loop)
+{
+    struct ndn_loop_item *item;
+    item = calloc(1, sizeof(*item));
+    if (item == NULL)
+        return(NULL);
+    item->fd = -1;
+    item->next = loop->items;
+    loop->items = item;
+    return(item);
+}
+
+/**
+ * Make the epoll registration of a handle match its current connection
+ */
+static int
+ndn_loop_sync_handle(struct ndn_loop *loop, struct ndn_loop_item *item)
+{
+    struct ndn *h = item->h;
+    struct epoll_event ev = {0};
+    int res;
+    if (item->fd == h->sock && item->connects == h->connects)
+        return(0);
+    /* a closed fd has already left the epoll set, so ignore errors here */
+    if (item->fd != -1)
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, item->fd, NULL);
+    item->fd = -1;
+    if (h->sock == -1)
+        return(0);
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.ptr = item;
+    res = epoll_ctl(loop->epfd, EPOLL_CTL_ADD, h->sock, &ev);
+    if (res == -1 && errno == EEXIST)
+        res = epoll_ctl(loop->epfd, EPOLL_CTL_MOD, h->sock, &ev);
+    if (res == -1)
+        return(NOTE_ERRNO(h));
+    item->fd = h->sock;
+    item->connects = h->connects;
+    return(0);
+}
+
+/**
+ * Add a handle to an event loop
+ *
+ * The handle may be connected before or after it is added.
+ * @returns -1 in case of error, 0 for success.
+ */
+int
+ndn_loop_add_handle(struct ndn_loop *loop, struct ndn *h)
+{
+    struct ndn_loop_item *item;
+    for (item = loop->items; item != NULL; item = item->next)
+        if (item->h == h && !item->dead)
+            return(NOTE_ERR(h, EINVAL));
+    item = ndn_loop_new_item(loop);
+    if (item == NULL)
+        return(NOTE_ERRNO(h));
+    item->h = h;
+    return(ndn_loop_sync_handle(loop, item));
+}
+
+static void
+ndn_loop_kill_item(struct ndn_loop *loop, struct ndn_loop_item *item)
+{
+    if (item->fd != -1)
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, item->fd, NULL);
+    item->fd = -1;
+    item->dead = 1;
+    loop->ndead++;
+    if (!loop->running)
+        ndn_loop_sweep(loop);
+}
+
+/**
+ * Remove a handle from an event loop
+ *
+ * This may be called from an upcall.
+ * @returns -1 if the handle was not there, 0 for success.
+ */
+int
+ndn_loop_remove_handle(struct ndn_loop *loop, struct ndn *h)
+{
+    struct ndn_loop_item *item;
+    for (item = loop->items; item != NULL; item = item->next) {
+        if (item->h == h && !item->dead) {
+            ndn_loop_kill_item(loop, item);
+            return(0);
+        }
+    }
+    return(-1);
+}
+
+/**
+ * Add an application fd to an event loop
+ *
+ * @param events is the set of epoll events of interest, e.g. EPOLLIN;
+ *        the registration is always edge-triggered.
+ * @param action is called from ndn_run_many when any of them are reported.
+ * @returns -1 in case of error (with errno set), 0 for success.
+ */
+int
+ndn_loop_add_fd(struct ndn_loop *loop, int fd, unsigned events,
+                ndn_loop_fd_action action, void *data)
+{
+    struct ndn_loop_item *item;
+    struct epoll_event ev = {0};
+    if (fd < 0 || action == NULL) {
+        errno = EINVAL;
+        return(-1);
+    }
+    item = ndn_loop_new_item(loop);
+    if (item == NULL)
+        return(-1);
+    item->action = action;
+    item->data = data;
+    ev.events = events | EPOLLET;
+    ev.data.ptr = item;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        ndn_loop_kill_item(loop, item);
+        return(-1);
+    }
+    item->fd = fd;
+    return(0);
+}
+
+/**
+ * Remove an application fd from an event loop
+ *
+ * This should be done before the fd is closed.  It may be called from
+ * an action or upcall.
+ * @returns -1 if the fd was not there, 0 for success.
+ */
+int
+ndn_loop_remove_fd(struct ndn_loop *loop, int fd)
+{
+    struct ndn_loop_item *item;
+    for (item = loop->items; item != NULL; item = item->next) {
+        if (item->h == NULL && item->fd == fd && !item->dead) {
+            ndn_loop_kill_item(loop, item);
+            return(0);
+        }
+    }
+    return(-1);
+}
+
+/**
+ * Modify the ndn_run_many timeout.
+ *
+ * Like ndn_set_run_timeout, this may be called from an action to make
+ * ndn_run_many return; calling ndn_set_run_timeout(h, 0) on any of the
+ * handles from an upcall has the same effect.
+ * @returns the old timeout value.
+ */
+int
+ndn_loop_set_timeout(struct ndn_loop *loop, int timeout)
+{
+    int ans = loop->timeout;
+    loop->timeout = timeout;
+    return(ans);
+}
+
+/**
+ * Service the readiness of one handle's connection
+ */
+static void
+ndn_loop_handle_io(struct ndn *h, unsigned events)
+{
+    int res = 0;
+    if ((events & EPOLLOUT) != 0)
+        ndn_pushout(h);
+    if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+        /* edge-triggered, so read until there is no more */
+        while (h->sock != -1 && (res = ndn_process_input(h)) > 0)
+            continue;
+    }
+    /* a read error will not be reported again, so give up on the connection */
+    if (h->sock != -1 && (res < 0 || h->err == ENOTCONN))
+        ndn_disconnect(h);
+}
+
+/**
+ * Run the event loop for several handles at once.
+ *
+ * This is the analogue of ndn_run for a set of handles added with
+ * ndn_loop_add_handle, plus any application fds added with ndn_loop_add_fd.
+ * All of them are serviced from the calling thread.
+ * @param loop is the event loop.
+ * @param timeout is in milliseconds, or -1 to run indefinitely.
+ * @returns a negative value for error, zero for success.
+ *          It is an error if no handle is connected and no fds are registered.
+ */
+int
+ndn_run_many(struct ndn_loop *loop, int timeout)
+{
+    struct epoll_event events[NDN_LOOP_MAX_EVENTS];
+    struct ndn_loop_item *item;
+    struct timeval start;
+    struct timeval now;
+    int microsec;
+    int millisec;
+    int live;
+    int stop;
+    int res = 0;
+    int i;
+
+    if (loop->running != 0) {
+        errno = EBUSY;
+        return(-1);
+    }
+    loop->running = 1;
+    loop->timeout = timeout;
+    for (item = loop->items; item != NULL; item = item->next)
+        if (item->h != NULL && !item->dead)
+            item->h->timeout = timeout;
+    gettimeofday(&start, NULL);
+    for (;;) {
+        microsec = -1;
+        live = 0;
+        for (item = loop->items; item != NULL; item = item->next) {
+            struct ndn *h = item->h;
+            int us;
+            if (item->dead)
+                continue;
+            if (h == NULL) {
+                live++;
+                continue;
+            }
+            if (h->sock == -1)
+                continue;
+            live++;
+            if (h->schedule != NULL) {
+                us = ndn_schedule_run(h->schedule);
+                if (us >= 0 && (microsec < 0 || us < microsec))
+                    microsec = us;
+            }
+            us = ndn_process_scheduled_operations(h);
+            if (microsec < 0 || us < microsec)
+                microsec = us;
+            ndn_loop_sync_handle(loop, item);
+        }
+        if (live == 0) {
+            res = -1;
             break;
         }
-        if (res > 0) {
-            if ((fds[0].revents | POLLOUT) != 0)
-                // puts("writing");
-                // 有东西要写
-                ndn_pushout(h);
-            if ((fds[0].revents | POLLIN) != 0)
-                // 有东西要读
-                // puts("reading");
-                ndn_process_input(h);
+        timeout = loop->timeout;
+        gettimeofday(&now, NULL);
+        millisec = (now.tv_sec  - start.tv_sec) * 1000 +
+                   (now.tv_usec - start.tv_usec) / 1000;
+        if (timeout >= 0 && millisec >= timeout)
+            break;
+        if (timeout >= 0)
+            timeout -= millisec;
+        millisec = (microsec < 0) ? -1 : microsec / 1000;
+        if (timeout >= 0 && (millisec < 0 || timeout < millisec))
+            millisec = timeout;
+        res = epoll_wait(loop->epfd, events, NDN_LOOP_MAX_EVENTS, millisec);
+        if (res < 0) {
+            if (errno != EINTR)
+                break;
+            res = 0;
         }
-        if (h->err == ENOTCONN)
-            // 记得关掉连接
-            ndn_disconnect(h);
-        if (h->timeout == 0)
+        for (i = 0; i < res; i++) {
+            item = events[i].data.ptr;
+            if (item->dead)
+                continue;
+            if (item->h != NULL)
+                ndn_loop_handle_io(item->h, events[i].events);
+            else
+                (item->action)(loop, item->fd, events[i].events, item->data);
+        }
+        res = 0;
+        stop = (loop->timeout == 0);
+        for (item = loop->items; item != NULL; item = item->next) {
+            if (item->h != NULL && !item->dead && item->h->timeout == 0)
+                stop = 1;
+        }
+        if (loop->ndead != 0)
+            ndn_loop_sweep(loop);
+        if (stop)
             break;
     }
-    if (h->running != 0)
-        abort();
-    return((res < 0) ? res : 0);
+    loop->running = 0;
+    if (loop->ndead != 0)
+        ndn_loop_sweep(loop);
+    return((res < 0) ? -1 : 0);
 }
 
+/* end of ndn_loop */
+#endif
+
 /**
  * Instance data associated with handle_simple_incoming_content()
  */
@@ -2182,6 +4271,8 @@ handle_simple_incoming_content(
     }
     if (kind == NDN_UPCALL_INTEREST_TIMED_OUT)
         return(selfp->intdata ? NDN_UPCALL_RESULT_REEXPRESS : NDN_UPCALL_RESULT_OK);
+    if (selfp->intdata == 0)
+        return(NDN_UPCALL_RESULT_OK); /* ndn_get has given up on this one */
     if (kind == NDN_UPCALL_CONTENT_UNVERIFIED) {
         if ((md->flags & NDN_GET_NOKEYWAIT) == 0)
             return(NDN_UPCALL_RESULT_VERIFY);
@@ -2209,6 +4300,76 @@ handle_simple_incoming_content(
     return(NDN_UPCALL_RESULT_OK);
 }
 
+/**
+ * Choose the handle to use for ndn_get and friends
+ *
+ * If h is NULL, or we are being called from an upcall, we need another
+ * connection.  With an original handle, this comes from its pool of spare
+ * connections if there is one; otherwise a new connection is made that
+ * borrows the keys of the original handle.
+ * @returns the handle to use, or NULL for error.
+ */
+static struct ndn *
+ndn_simple_handle(struct ndn *orig_h)
+{
+    struct ndn *h = orig_h;
+    int res;
+    // 我传进来的不是null
+    if (h != NULL && h->running == 0)
+        return(h);
+    if (orig_h != NULL) {
+        while ((h = orig_h->spare) != NULL) {
+            orig_h->spare = h->spare;
+            orig_h->n_spare--;
+            h->spare = NULL;
+            if (h->sock != -1) {
+                h->key_cache = orig_h->key_cache;
+                return(h);
+            }
+            h->keys = NULL;
+            ndn_destroy(&h);
+        }
+    }
+    h = ndn_create();
+    if (h == NULL)
+        return(NULL);
+    if (orig_h != NULL) { /* Dad, can I borrow the keys? 可以.*/
+        hashtb_destroy(&h->keys);
+        h->keys = orig_h->keys;
+        h->key_cache = orig_h->key_cache;
+    }
+    res = ndn_connect(h, orig_h ? ndn_get_connect_type(orig_h) : NULL);
+    if (res < 0) {
+        if (orig_h != NULL)
+            h->keys = NULL;
+        ndn_destroy(&h);
+        return(NULL);
+    }
+    return(h);
+}
+
+/**
+ * Finish with a handle obtained from ndn_simple_handle
+ *
+ * A borrowed connection that is still good goes back into the pool.
+ */
+static void
+ndn_simple_handle_done(struct ndn *orig_h, struct ndn *h)
+{
+    if (h == orig_h)
+        return;
+    if (orig_h != NULL) {
+        if (h->sock != -1 && orig_h->n_spare < NDN_MAX_SPARE_HANDLES) {
+            h->spare = orig_h->spare;
+            orig_h->spare = h;
+            orig_h->n_spare++;
+            return;
+        }
+        h->keys = NULL;
+    }
+    ndn_destroy(&h);
+}
+
 /**
  * 获得一个符合的ContentObject
  * 可以很方便的获得.
@@ -2250,27 +4411,14 @@ ndn_get(struct ndn *h,
         int flags)
 {
     struct ndn *orig_h = h;
-    struct hashtb *saved_keys = NULL;
     int res;
     struct simple_get_data *md;
 
     if ((flags & ~((int)NDN_GET_NOKEYWAIT)) != 0)
         return(-1);
-    // 我传进来的不是null
-    if (h == NULL || h->running) {
-        h = ndn_create();
-        if (h == NULL)
-            return(-1);
-        if (orig_h != NULL) { /* Dad, can I borrow the keys? 可以.*/
-            saved_keys = h->keys;
-            h->keys = orig_h->keys;
-        }
-        res = ndn_connect(h, ndn_get_connect_type(orig_h));
-        if (res < 0) {
-            ndn_destroy(&h);
-            return(-1);
-        }
-    }
+    h = ndn_simple_handle(orig_h);
+    if (h == NULL)
+        return(-1);
     md = calloc(1, sizeof(*md));
     md->resultbuf = resultbuf;
     md->pcobuf = pcobuf;
@@ -2295,14 +4443,267 @@ ndn_get(struct ndn *h,
     md->closure.refcount--;
     if (md->closure.refcount == 0)
         free(md);
-    if (h != orig_h) {
-        if (saved_keys != NULL)
-            h->keys = saved_keys;
-        ndn_destroy(&h);
+    ndn_simple_handle_done(orig_h, h);
+    return(res);
+}
+
+/* * * ndn_get_many * * */
+
+/**
+ * State for one call of ndn_get_many
+ */
+struct get_many_data {
+    struct ndn *h;
+    struct ndn_get_item *items;
+    struct get_many_item **inflight; /* indexed like items */
+    int n;
+    int next;                   /* index of next item to ask for */
+    int n_inflight;
+    int n_done;
+    int window;
+    int timeout_ms;
+    int flags;
+    int stop;                   /* do not ask for any more */
+    ndn_get_item_action action;
+    void *data;
+};
+
+/**
+ * Instance data for each outstanding item of ndn_get_many
+ *
+ * Like simple_get_data, this may outlive the call if the interest is still
+ * pending, in which case md will be NULL.
+ */
+struct get_many_item {
+    struct ndn_closure closure;
+    struct get_many_data *md;
+    int i;
+    struct ndn_scheduled_event *ev; /* the deadline for this item */
+};
+
+static void get_many_issue(struct get_many_data *md);
+
+/**
+ * Mark an item done
+ *
+ * This does not ask for more; callers outside of get_many_issue do that
+ * afterwards, so that only the loop there ever expresses interests and
+ * a run of failures cannot nest.
+ */
+static void
+get_many_finish(struct get_many_item *it, int res)
+{
+    struct get_many_data *md = it->md;
+    struct ndn_get_item *item;
+
+    if (md == NULL)
+        return;
+    it->md = NULL;
+    ndn_cancel_timer(md->h, &it->ev);
+    md->inflight[it->i] = NULL;
+    it->closure.refcount--; /* our reference */
+    item = &md->items[it->i];
+    item->res = res;
+    md->n_inflight--;
+    md->n_done++;
+    if (md->action != NULL)
+        (md->action)(md->h, item, md->data);
+    if (md->n_done == md->n)
+        ndn_set_run_timeout(md->h, 0);
+}
+
+/**
+ * Upcall for the items of ndn_get_many
+ */
+static enum ndn_upcall_res
+handle_get_many_content(struct ndn_closure *selfp,
+                        enum ndn_upcall_kind kind,
+                        struct ndn_upcall_info *info)
+{
+    struct get_many_item *it = selfp->data;
+    struct get_many_data *md = it->md;
+    struct ndn_charbuf *resultbuf;
+
+    if (kind == NDN_UPCALL_FINAL) {
+        if (selfp != &it->closure)
+            abort();
+        free(it);
+        return(NDN_UPCALL_RESULT_OK);
+    }
+    if (md == NULL)
+        return(NDN_UPCALL_RESULT_OK);
+    if (kind == NDN_UPCALL_INTEREST_TIMED_OUT)
+        return(NDN_UPCALL_RESULT_REEXPRESS);
+    if (kind == NDN_UPCALL_CONTENT_UNVERIFIED) {
+        if ((md->flags & NDN_GET_NOKEYWAIT) == 0)
+            return(NDN_UPCALL_RESULT_VERIFY);
+    }
+    else if (kind == NDN_UPCALL_CONTENT_KEYMISSING) {
+        if ((md->flags & NDN_GET_NOKEYWAIT) == 0)
+            return(NDN_UPCALL_RESULT_FETCHKEY);
+    }
+    else if (kind != NDN_UPCALL_CONTENT && kind != NDN_UPCALL_CONTENT_RAW) {
+        get_many_finish(it, -1);
+        get_many_issue(md);
+        return(NDN_UPCALL_RESULT_ERR);
+    }
+    resultbuf = md->items[it->i].resultbuf;
+    if (resultbuf != NULL) {
+        resultbuf->length = 0;
+        ndn_charbuf_append(resultbuf,
+                           info->content_ndnb, info->pco->offset[NDN_PCO_E]);
+    }
+    get_many_finish(it, 0);
+    get_many_issue(md);
+    return(NDN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Scheduled action for the deadline of an item of ndn_get_many
+ */
+static int
+get_many_timeout(struct ndn_schedule *sched,
+                 void *clienth,
+                 struct ndn_scheduled_event *ev,
+                 int flags)
+{
+    struct get_many_item *it = ev->evdata;
+    struct get_many_data *md = it->md;
+    if ((flags & NDN_SCHEDULE_CANCEL) != 0)
+        return(0);
+    it->ev = NULL;
+    get_many_finish(it, -1);
+    if (md != NULL)
+        get_many_issue(md);
+    return(0);
+}
+
+/**
+ * Ask for more items, as long as the window allows
+ */
+static void
+get_many_issue(struct get_many_data *md)
+{
+    struct get_many_item *it;
+    struct ndn_get_item *item;
+    struct ndn_schedule *sched;
+    int res;
+
+    while (!md->stop && md->n_inflight < md->window && md->next < md->n) {
+        item = &md->items[md->next];
+        it = calloc(1, sizeof(*it));
+        if (it == NULL) {
+            NOTE_ERRNO(md->h);
+            md->stop = 1;
+            return;
+        }
+        it->md = md;
+        it->i = md->next++;
+        it->closure.p = &handle_get_many_content;
+        it->closure.data = it;
+        it->closure.refcount = 1;
+        md->inflight[it->i] = it;
+        md->n_inflight++;
+        sched = ndn_timer_sched(md->h);
+        if (sched != NULL)
+            it->ev = ndn_schedule_event(sched, md->timeout_ms * 1000,
+                                        &get_many_timeout, it, 0);
+        res = ndn_express_interest(md->h, item->name, &it->closure,
+                                   item->interest_template);
+        if (res < 0 || it->ev == NULL)
+            get_many_finish(it, -1);
+        if (it->closure.refcount == 0)
+            free(it);
+    }
+}
+
+/**
+ * Get a batch of ContentObjects, keeping several interests outstanding
+ *
+ * This is like calling ndn_get for each of the items, except that up to
+ * window of them are asked for at once.  Blocks until every item has
+ * either been answered or timed out.
+ * @param h is the ndn handle.  As with ndn_get, if it is NULL or we are
+ *        called from inside an upcall, a separate connection is used.
+ * @param items is the array of requests; the res field of each is set,
+ *        and its resultbuf, if not NULL, receives the ContentObject.
+ * @param n is the number of items.
+ * @param window is the largest number of interests to have outstanding.
+ * @param timeout_ms limits the time spent on each item, counted from when
+ *        its interest is first expressed (milliseconds).
+ * @param flags - NDN_GET_NOKEYWAIT as for ndn_get.
+ * @param action, if not NULL, is called as each item completes.
+ * @param data is passed to action.
+ * @returns the number of items fetched successfully, or -1 for an error.
+ */
+int
+ndn_get_many(struct ndn *h,
+             struct ndn_get_item *items,
+             int n,
+             int window,
+             int timeout_ms,
+             int flags,
+             ndn_get_item_action action,
+             void *data)
+{
+    struct ndn *orig_h = h;
+    struct get_many_data md_store = {0};
+    struct get_many_data *md = &md_store;
+    struct get_many_item *it;
+    int res = 0;
+    int i;
+
+    if ((flags & ~((int)NDN_GET_NOKEYWAIT)) != 0 || n < 0 || timeout_ms < 0)
+        return(-1);
+    if (window < 1)
+        window = 1;
+    for (i = 0; i < n; i++)
+        items[i].res = -1;
+    if (n == 0)
+        return(0);
+    md->inflight = calloc(n, sizeof(md->inflight[0]));
+    if (md->inflight == NULL)
+        return(-1);
+    h = ndn_simple_handle(orig_h);
+    if (h == NULL) {
+        free(md->inflight);
+        return(-1);
+    }
+    md->h = h;
+    md->items = items;
+    md->n = n;
+    md->window = window;
+    md->timeout_ms = timeout_ms;
+    md->flags = flags;
+    md->action = action;
+    md->data = data;
+    if (timeout_ms > INT_MAX / 1000)
+        md->timeout_ms = INT_MAX / 1000;
+    get_many_issue(md);
+    while (res >= 0 && md->n_done < md->n)
+        res = ndn_run(h, -1);
+    /* Anything left over has failed */
+    md->stop = 1;
+    for (i = 0; i < n; i++) {
+        it = md->inflight[i];
+        if (it != NULL) {
+            get_many_finish(it, -1);
+            if (it->closure.refcount == 0)
+                free(it);
+        }
     }
+    free(md->inflight);
+    ndn_simple_handle_done(orig_h, h);
+    if (res < 0)
+        return(-1);
+    for (i = 0, res = 0; i < n; i++)
+        if (items[i].res == 0)
+            res++;
     return(res);
 }
 
+/* end of ndn_get_many */
+
 /**
  * Upcall to handle response to fetch a ndndid
  */
@@ -2427,6 +4828,7 @@ handle_prefix_reg_reply(
     if (md->interest_filter != NULL) {
         md->interest_filter->expiry = h->now;
         md->interest_filter->expiry.tv_sec += lifetime;
+        ndn_arm_ifilt_timer(h, md->interest_filter);
     }
     ndn_forwarding_entry_destroy(&fe);
     return(NDN_UPCALL_RESULT_OK);
@@ -2802,11 +5204,12 @@ ndn_load_or_create_default_key(struct ndn *h)
         return(NOTE_ERRNO(h));
     s = getenv("NDNX_DIR");
     if (s != NULL && s[0] != 0)
-        ndn_charbuf_putf(path, "%s", s);
+        ndn_charbuf_append_string(path, s);
     else {
         s = getenv("HOME");
         if (s != NULL && s[0] != 0) {
-            ndn_charbuf_putf(path, "%s/.ndnx", s);
+            ndn_charbuf_append_string(path, s);
+            ndn_charbuf_append_string(path, "/.ndnx");
             res = mkdir(ndn_charbuf_as_string(path), S_IRWXU);
             if (res == -1) {
                 if (errno == EEXIST)
@@ -2818,7 +5221,7 @@ ndn_load_or_create_default_key(struct ndn *h)
         else
             res = NOTE_ERR(h, -1);
     }
-    ndn_charbuf_putf(path, "/%s", ".ndnx_keystore");
+    ndn_charbuf_append_string(path, "/.ndnx_keystore");
     res = ndn_load_or_create_key(h,
                                  ndn_charbuf_as_string(path),
                                  default_pubid);
@@ -2972,34 +5375,13 @@ ndn_chk_signing_params(struct ndn *h,
     return(res);
 }
 
-/**
- * Create a signed ContentObject.
- *
- * 创建签名的ContentObject
- * 参数
- * h => ndn handle
- * resultbuf => 输出的ContentObject就会存在里面
- * name_prefix => 输入的 ndnb 名字前缀
- * params => 参数.sp
- * data => 输入的原始数据内容
- * size => data 的 size
- * 返回
- * 0 成功 -1 失败
- *
- * @param h is the ndn handle
- * @param resultbuf - result buffer to which the ContentObject will be appended
- * @param name_prefix contains the ndnb-encoded name
- * @param params describe the ancillary information needed
- * @param data points to the raw content
- * @param size is the size of the raw content, in bytes
- * @returns 0 for success, -1 for error
- */
-int
-ndn_sign_content(struct ndn *h,
-                 struct ndn_charbuf *resultbuf,
-                 const struct ndn_charbuf *name_prefix,
-                 const struct ndn_signing_params *params,
-                 const void *data, size_t size)
+static int
+sign_content(struct ndn *h,
+             struct ndn_charbuf *resultbuf,
+             struct iovec *iov,
+             const struct ndn_charbuf *name_prefix,
+             const struct ndn_signing_params *params,
+             const void *data, size_t size)
 {
     struct hashtb_enumerator ee;
     struct hashtb_enumerator *e = &ee;
@@ -3037,7 +5419,7 @@ ndn_sign_content(struct ndn *h,
             const unsigned char *comp = NULL;
             size_t size = 0;
 
-            ndx = ndn_indexbuf_create();
+            ndx = ndn_indexbuf_obtain(h);
             ncomp = ndn_name_split(name_prefix, ndx);
             if (ncomp < 0)
                 res = NOTE_ERR(h, EINVAL);
@@ -3048,7 +5430,7 @@ ndn_sign_content(struct ndn *h,
                 ndn_charbuf_append_tt(finalblockid, size, NDN_BLOB);
                 ndn_charbuf_append(finalblockid, comp, size);
             }
-            ndn_indexbuf_destroy(&ndx);
+            ndn_indexbuf_release(h, ndx);
         }
         if (res >= 0)
             res = ndn_signed_info_create(signed_info,
@@ -3070,7 +5452,16 @@ ndn_sign_content(struct ndn *h,
             else
                 NOTE_ERR(h, -1);
         }
-        if (res >= 0)
+        if (res >= 0 && iov != NULL)
+            res = ndn_encode_ContentObject_iov(resultbuf,
+                                               iov,
+                                               name_prefix,
+                                               signed_info,
+                                               data,
+                                               size,
+                                               ndn_keystore_digest_algorithm(keystore),
+                                               ndn_keystore_private_key(keystore));
+        else if (res >= 0)
             res = ndn_encode_ContentObject(resultbuf,
                                            name_prefix,
                                            signed_info,
@@ -3090,6 +5481,64 @@ ndn_sign_content(struct ndn *h,
     ndn_charbuf_destroy(&signed_info);
     return(res);
 }
+
+/**
+ * Create a signed ContentObject.
+ *
+ * 创建签名的ContentObject
+ * 参数
+ * h => ndn handle
+ * resultbuf => 输出的ContentObject就会存在里面
+ * name_prefix => 输入的 ndnb 名字前缀
+ * params => 参数.sp
+ * data => 输入的原始数据内容
+ * size => data 的 size
+ * 返回
+ * 0 成功 -1 失败
+ *
+ * @param h is the ndn handle
+ * @param resultbuf - result buffer to which the ContentObject will be appended
+ * @param name_prefix contains the ndnb-encoded name
+ * @param params describe the ancillary information needed
+ * @param data points to the raw content
+ * @param size is the size of the raw content, in bytes
+ * @returns 0 for success, -1 for error
+ */
+int
+ndn_sign_content(struct ndn *h,
+                 struct ndn_charbuf *resultbuf,
+                 const struct ndn_charbuf *name_prefix,
+                 const struct ndn_signing_params *params,
+                 const void *data, size_t size)
+{
+    return(sign_content(h, resultbuf, NULL, name_prefix, params, data, size));
+}
+
+/**
+ * Create a signed ContentObject, leaving the payload where it is.
+ *
+ * This is ndn_sign_content for producers that serve large payloads,
+ * such as segments of an mmapped file.  The start of the object is
+ * appended to headbuf, and iov is filled in to describe the whole
+ * object, with the payload itself as one of the pieces.  Pass it to
+ * ndn_put_iov to send it without copying the payload.
+ * @param headbuf is where the start of the object is appended; it must
+ *        not change while iov is in use.
+ * @param iov is filled in with NDN_CONTENTOBJECT_IOV pieces.
+ * @returns the number of pieces, or -1 for error.
+ */
+int
+ndn_sign_content_iov(struct ndn *h,
+                     struct ndn_charbuf *headbuf,
+                     struct iovec *iov,
+                     const struct ndn_charbuf *name_prefix,
+                     const struct ndn_signing_params *params,
+                     const void *data, size_t size)
+{
+    if (iov == NULL)
+        return(NOTE_ERR(h, EINVAL));
+    return(sign_content(h, headbuf, iov, name_prefix, params, data, size));
+}
 /**
  * Check whether content described by info is final block.
  *
@@ -3186,7 +5635,7 @@ ndn_guest_prefix(struct ndn *h, struct ndn_charbuf *result, int ms)
     ndn_charbuf_append_tt(templ, NDN_DTAG_Interest, NDN_DTAG);
     ndn_charbuf_append_tt(templ, NDN_DTAG_Name, NDN_DTAG);
     ndn_charbuf_append_closer(templ); /* </Name> */
-    ndnb_tagged_putf(templ, NDN_DTAG_Scope, "%d", 2);
+    ndnb_append_tagged_number(templ, NDN_DTAG_Scope, 2);
     ndn_charbuf_append_closer(templ); /* </Interest> */
     res = ndn_resolve_version(h, name, NDN_V_HIGHEST, ms);
     if (res < 0)
@@ -0,0 +1,36 @@
+/**
+ * @file ndn_coding.h
+ * @brief Additions to the ndnb encoding and decoding routines.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_CODING_EXT_DEFINED
+#define NDN_CODING_EXT_DEFINED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ndn/charbuf.h>
+#include <ndn/coding.h>
+
+int ndn_message_dtag(const unsigned char *msg, size_t size);
+
+int ndnb_append_tagged_udata(struct ndn_charbuf *c, enum ndn_dtag dtag,
+                             const void *data, size_t size);
+int ndnb_append_tagged_number(struct ndn_charbuf *c, enum ndn_dtag dtag,
+                              uintmax_t val);
+
+#endif
@@ -0,0 +1,53 @@
+/**
+ * @file ndn_get_many.h
+ * @brief Pipelined retrieval of a batch of ContentObjects.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_GET_MANY_DEFINED
+#define NDN_GET_MANY_DEFINED
+
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+
+/**
+ * One request in a batch for ndn_get_many
+ */
+struct ndn_get_item {
+    struct ndn_charbuf *name;   /**< ndnb-encoded Name */
+    struct ndn_charbuf *interest_template; /**< may be NULL */
+    struct ndn_charbuf *resultbuf; /**< gets the ContentObject; may be NULL */
+    int res;                    /**< 0 for success, -1 for error or timeout */
+};
+
+/**
+ * Called by ndn_get_many as each item completes, successfully or not
+ */
+typedef void (*ndn_get_item_action)(struct ndn *h,
+                                    struct ndn_get_item *item,
+                                    void *data);
+
+int ndn_get_many(struct ndn *h,
+                 struct ndn_get_item *items,
+                 int n,
+                 int window,
+                 int timeout_ms,
+                 int flags,
+                 ndn_get_item_action action,
+                 void *data);
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file ndn_hashtb.h
+ * @brief Extensions to the hash table: engines, hashes, snapshots and
+ *        shared tables.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_HASHTB_EXT_DEFINED
+#define NDN_HASHTB_EXT_DEFINED
+
+#include <stddef.h>
+#include <ndn/hashtb.h>
+
+/*
+ * Flags for hashtb_create_flags
+ */
+#define HASHTB_OPEN_ADDRESSING    0x01 /**< open addressing, not chaining */
+#define HASHTB_INCREMENTAL_REHASH 0x02 /**< grow a little at each seek */
+#define HASHTB_SEEDED_HASH        0x04 /**< use hashtb_hash_seeded */
+#define HASHTB_POOLED             0x08 /**< take small nodes from a pool */
+#define HASHTB_PREFIX_HASH        0x10 /**< use hashtb_hash_prefix */
+
+struct hashtb *hashtb_create_flags(size_t item_size,
+                                   const struct hashtb_param *param,
+                                   unsigned flags);
+
+/*
+ * Hashes, and lookup by a hash the caller already has
+ */
+size_t hashtb_hash_seeded(const unsigned char *key, size_t key_size);
+size_t hashtb_hash_prefix(const unsigned char *key, size_t key_size);
+void hashtb_hash_prefixes(const unsigned char *buf, const size_t *ends, int n,
+                          size_t *hashes);
+void *hashtb_lookup_hashed(struct hashtb *ht, const void *key, size_t keysize,
+                           size_t h);
+
+/*
+ * Sizing and snapshots
+ */
+int hashtb_reserve(struct hashtb *ht, int n);
+int hashtb_bulk_load(struct hashtb *ht, struct hashtb *from);
+int hashtb_snapshot_write(struct hashtb *ht, const char *path);
+struct hashtb *hashtb_snapshot_open(const char *path);
+
+/*
+ * Tables shared among threads
+ */
+struct hashtb_shared;
+
+struct hashtb_shared *hashtb_shared_create(size_t item_size,
+                                           const struct hashtb_param *param,
+                                           unsigned flags);
+void hashtb_shared_destroy(struct hashtb_shared **shp);
+int hashtb_shared_n(struct hashtb_shared *sh);
+void *hashtb_shared_lookup(struct hashtb_shared *sh,
+                           const void *key, size_t keysize);
+void *hashtb_shared_insert(struct hashtb_shared *sh,
+                           const void *key, size_t keysize, size_t extsize,
+                           const void *data, int *added);
+
+#endif
@@ -25,6 +25,8 @@
 #include <string.h>
 #include <ndn/indexbuf.h>
 
+#include "ndn_arena.h"
+
 #define ELEMENT size_t
 
 /**
@@ -46,6 +48,11 @@ ndn_indexbuf_destroy(struct ndn_indexbuf **cbp)
 {
     struct ndn_indexbuf *c = *cbp;
     if (c != NULL) {
+        /* arena buffers go back all at once when the arena is left */
+        if (ndn_arena_owner(c) != NULL) {
+            *cbp = NULL;
+            return;
+        }
         if (c->buf != NULL) {
             free(c->buf);
         }
@@ -64,22 +71,33 @@ ndn_indexbuf_reserve(struct ndn_indexbuf *c, size_t n)
     size_t newlim = n + c->n;
     size_t oldlim = c->limit;
     ELEMENT *buf = c->buf;
+    struct ndn_arena *a;
     if (newlim < n)
         return(NULL);
     if (newlim > oldlim) {
         if (2 * oldlim > newlim)
             newlim = 2 * oldlim;
+        a = ndn_arena_owner(c);
+        if (a != NULL) {
+            buf = ndn_arena_alloc(a, newlim * sizeof(ELEMENT));
+            if (buf == NULL)
+                return(NULL);
+            if (oldlim != 0)
+                memcpy(buf, c->buf, oldlim * sizeof(ELEMENT));
+        }
+        else {
 #ifdef NDN_NOREALLOC
-        buf = malloc(newlim * sizeof(ELEMENT));
-        if (buf == NULL)
-            return(NULL);
-        memcpy(buf, c->buf, oldlim * sizeof(ELEMENT));
-        free(c->buf);
+            buf = malloc(newlim * sizeof(ELEMENT));
+            if (buf == NULL)
+                return(NULL);
+            memcpy(buf, c->buf, oldlim * sizeof(ELEMENT));
+            free(c->buf);
 #else
-        buf = realloc(c->buf, newlim * sizeof(ELEMENT));
-        if (buf == NULL)
-            return(NULL);
+            buf = realloc(c->buf, newlim * sizeof(ELEMENT));
+            if (buf == NULL)
+                return(NULL);
 #endif
+        }
         memset(buf + oldlim, 0, (newlim - oldlim) * sizeof(ELEMENT));
         c->buf = buf;
         c->limit = newlim;
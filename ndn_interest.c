@@ -1,6 +1,7 @@
 /**
  * @file ndn_interest.c
- * Accessors and mutators for parsed Interest messages
+ * Accessors and mutators for parsed Interest messages,
+ * and compiled interest templates
  */
 
 /*
@@ -23,9 +24,16 @@
  * Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ndn/ndn.h>
 #include <ndn/charbuf.h>
 #include <ndn/coding.h>
+#include <ndn/indexbuf.h>
+#include <ndn/random.h>
+
+#include "ndn_interest_template.h"
 
 /**
  * @returns the lifetime of the interest in units of 2**(-12) seconds
@@ -64,3 +72,231 @@ ndn_interest_lifetime_seconds(const unsigned char *msg,
         return(val);
     return(val >> 12);
 }
+
+/**
+ * A compiled interest template.
+ *
+ * Every interest built from one template has the same bytes except for
+ * the Name and the Nonce value.  So the template is made once into
+ * a complete interest with an empty Name (wire), and the parse of that
+ * (pi) gives the offsets of any other interest by shifting.
+ */
+struct ndn_interest_template {
+    struct ndn_charbuf *wire;   /* the interest with an empty Name */
+    size_t name_start;          /* where the Name goes in wire */
+    size_t name_end;            /* end of the empty Name in wire */
+    size_t nonce_start;         /* where the Nonce value goes in wire */
+    size_t nonce_size;          /* 0 for no Nonce */
+    intmax_t lifetime;          /* in units of 2**(-12) seconds */
+    struct ndn_parsed_interest pi; /* of wire */
+};
+
+/**
+ * Compile an interest template.
+ *
+ * The selectors and other fields of the template are kept as they are.
+ * Any Name or Nonce in the template is dropped, as ndn_express_interest
+ * would do.
+ * @param interest_template is an ndnb-encoded Interest, or NULL for
+ *        none.
+ * @param nonce_size is the size of the Nonce that goes into each
+ *        interest, or 0 for no Nonce.
+ * @returns the new template, or NULL if interest_template does not parse
+ *          or nonce_size is not acceptable.
+ */
+struct ndn_interest_template *
+ndn_interest_template_create(const struct ndn_charbuf *interest_template,
+                             size_t nonce_size)
+{
+    static const unsigned char zeros[64] = {0};
+    struct ndn_interest_template *t = NULL;
+    struct ndn_parsed_interest pi = {0};
+    struct ndn_charbuf *c = NULL;
+    const unsigned char *tb = NULL;
+    size_t start;
+    size_t size;
+    int res;
+
+    if (nonce_size > sizeof(zeros))
+        return(NULL);
+    if (interest_template != NULL) {
+        tb = interest_template->buf;
+        res = ndn_parse_interest(tb, interest_template->length, &pi, NULL);
+        if (res < 0)
+            return(NULL);
+    }
+    t = calloc(1, sizeof(*t));
+    if (t == NULL)
+        return(NULL);
+    t->wire = c = ndn_charbuf_create();
+    if (c == NULL)
+        goto Bail;
+    res = ndn_charbuf_append_tt(c, NDN_DTAG_Interest, NDN_DTAG);
+    t->name_start = c->length;
+    res |= ndn_charbuf_append_tt(c, NDN_DTAG_Name, NDN_DTAG);
+    res |= ndn_charbuf_append_closer(c); /* </Name> */
+    t->name_end = c->length;
+    if (tb != NULL) {
+        start = pi.offset[NDN_PI_E_Name];
+        size = pi.offset[NDN_PI_B_Nonce] - start;
+        res |= ndn_charbuf_append(c, tb + start, size);
+    }
+    t->nonce_size = nonce_size;
+    if (nonce_size != 0) {
+        res |= ndn_charbuf_append_tt(c, NDN_DTAG_Nonce, NDN_DTAG);
+        res |= ndn_charbuf_append_tt(c, nonce_size, NDN_BLOB);
+        t->nonce_start = c->length;
+        res |= ndn_charbuf_append(c, zeros, nonce_size);
+        res |= ndn_charbuf_append_closer(c); /* </Nonce> */
+    }
+    if (tb != NULL) {
+        start = pi.offset[NDN_PI_B_OTHER];
+        size = pi.offset[NDN_PI_E_OTHER] - start;
+        if (size != 0)
+            res |= ndn_charbuf_append(c, tb + start, size);
+    }
+    res |= ndn_charbuf_append_closer(c); /* </Interest> */
+    if (nonce_size == 0)
+        t->nonce_start = c->length;
+    if (res < 0)
+        goto Bail;
+    /* This also checks that nonce_size is acceptable */
+    res = ndn_parse_interest(c->buf, c->length, &t->pi, NULL);
+    if (res < 0)
+        goto Bail;
+    t->lifetime = ndn_interest_lifetime(c->buf, &t->pi);
+    return(t);
+Bail:
+    ndn_interest_template_destroy(&t);
+    return(NULL);
+}
+
+void
+ndn_interest_template_destroy(struct ndn_interest_template **tp)
+{
+    struct ndn_interest_template *t = *tp;
+    if (t != NULL) {
+        ndn_charbuf_destroy(&t->wire);
+        free(t);
+        *tp = NULL;
+    }
+}
+
+/**
+ * @returns the lifetime of interests made from the template, in units
+ * of 2**(-12) seconds.
+ */
+intmax_t
+ndn_interest_template_lifetime(const struct ndn_interest_template *t)
+{
+    return(t->lifetime);
+}
+
+/**
+ * @returns the size of the Nonce in interests made from the template,
+ * or 0 if they have none.
+ */
+size_t
+ndn_interest_template_nonce_size(const struct ndn_interest_template *t)
+{
+    return(t->nonce_size);
+}
+
+/**
+ * @returns the size of the interest that the template makes for a Name
+ *          of name_size bytes.
+ */
+size_t
+ndn_interest_template_size(const struct ndn_interest_template *t,
+                           size_t name_size)
+{
+    return(t->wire->length - (t->name_end - t->name_start) + name_size);
+}
+
+/**
+ * Make an interest from a compiled template.
+ *
+ * Only the Name and the Nonce are filled in; the rest is copied from
+ * the template as it is.
+ * @param name is the ndnb-encoded Name, which is not checked here.
+ * @param nonce has the nonce_size bytes given to
+ *        ndn_interest_template_create, or is NULL to use random ones.
+ *        It is not used if the template has no Nonce.
+ * @param buf is where the interest goes.
+ * @param bufsize is the room at buf.
+ * @returns the size of the interest, or -1 if it does not fit.
+ */
+int
+ndn_interest_template_emit(const struct ndn_interest_template *t,
+                           const unsigned char *name, size_t name_size,
+                           const unsigned char *nonce,
+                           unsigned char *buf, size_t bufsize)
+{
+    const unsigned char *w = t->wire->buf;
+    size_t size = ndn_interest_template_size(t, name_size);
+    size_t mid = t->nonce_start - t->name_end;
+    size_t rest = t->wire->length - t->nonce_start;
+    unsigned char *p = buf;
+
+    if (size > bufsize || size > INT_MAX)
+        return(-1);
+    memcpy(p, w, t->name_start);
+    p += t->name_start;
+    memcpy(p, name, name_size);
+    p += name_size;
+    memcpy(p, w + t->name_end, mid);
+    p += mid;
+    if (t->nonce_size != 0) {
+        if (nonce != NULL)
+            memcpy(p, nonce, t->nonce_size);
+        else
+            ndn_random_bytes(p, t->nonce_size);
+        p += t->nonce_size;
+        rest -= t->nonce_size;
+    }
+    memcpy(p, w + t->wire->length - rest, rest);
+    return(size);
+}
+
+/**
+ * Get the parse of an interest made by ndn_interest_template_emit,
+ * without parsing more than its Name.
+ * @param name is the Name that was given to ndn_interest_template_emit.
+ * @param pi is filled in as ndn_parse_interest would.
+ * @param components must not be NULL, and is filled in with the
+ *        Component boundary offsets.
+ * @returns the number of Components in the Name, or -1 if it is not
+ *          a valid Name.
+ */
+int
+ndn_interest_template_parsed(const struct ndn_interest_template *t,
+                             const unsigned char *name, size_t name_size,
+                             struct ndn_parsed_interest *pi,
+                             struct ndn_indexbuf *components)
+{
+    struct ndn_buf_decoder decoder;
+    struct ndn_buf_decoder *d;
+    size_t base = t->name_start;
+    size_t delta;
+    int ncomp;
+    int i;
+
+    d = ndn_buf_decoder_start(&decoder, name, name_size);
+    ncomp = ndn_parse_Name(d, components);
+    if (ncomp < 0 || d->decoder.index != name_size)
+        return(-1);
+    for (i = 0; i < components->n; i++)
+        components->buf[i] += base;
+    *pi = t->pi;
+    /* All the offsets past the Name move by the same amount */
+    delta = name_size - (t->name_end - t->name_start);
+    for (i = NDN_PI_E_Name; i <= NDN_PI_E; i++)
+        pi->offset[i] += delta;
+    pi->offset[NDN_PI_B_Name] = base;
+    pi->offset[NDN_PI_B_Component0] = components->buf[0];
+    pi->offset[NDN_PI_E_ComponentLast] = base + name_size - 1;
+    pi->prefix_comps = ncomp;
+    pi->offset[NDN_PI_B_LastPrefixComponent] = components->buf[(ncomp > 0) ? (ncomp - 1) : 0];
+    pi->offset[NDN_PI_E_LastPrefixComponent] = components->buf[ncomp];
+    return(ncomp);
+}
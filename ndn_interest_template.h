@@ -0,0 +1,59 @@
+/**
+ * @file ndn_interest_template.h
+ * @brief Interest templates compiled once and used for many interests.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_INTEREST_TEMPLATE_DEFINED
+#define NDN_INTEREST_TEMPLATE_DEFINED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+#include <ndn/indexbuf.h>
+
+/**
+ * A compiled interest template, from ndn_interest_template_create.
+ */
+struct ndn_interest_template;
+
+struct ndn_interest_template *
+ndn_interest_template_create(const struct ndn_charbuf *interest_template,
+                             size_t nonce_size);
+void ndn_interest_template_destroy(struct ndn_interest_template **tp);
+
+intmax_t ndn_interest_template_lifetime(const struct ndn_interest_template *t);
+size_t ndn_interest_template_nonce_size(const struct ndn_interest_template *t);
+size_t ndn_interest_template_size(const struct ndn_interest_template *t,
+                                  size_t name_size);
+
+int ndn_interest_template_emit(const struct ndn_interest_template *t,
+                               const unsigned char *name, size_t name_size,
+                               const unsigned char *nonce,
+                               unsigned char *buf, size_t bufsize);
+int ndn_interest_template_parsed(const struct ndn_interest_template *t,
+                                 const unsigned char *name, size_t name_size,
+                                 struct ndn_parsed_interest *pi,
+                                 struct ndn_indexbuf *components);
+
+int ndn_express_interest_compiled(struct ndn *h,
+                                  struct ndn_charbuf *namebuf,
+                                  struct ndn_closure *action,
+                                  const struct ndn_interest_template *t);
+
+#endif
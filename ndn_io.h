@@ -0,0 +1,41 @@
+/**
+ * @file ndn_io.h
+ * @brief Controls on how a handle buffers its connection to ndnd.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_IO_DEFINED
+#define NDN_IO_DEFINED
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <ndn/ndn.h>
+
+ssize_t ndn_set_input_buffer_size(struct ndn *h, size_t size);
+
+/**
+ * Called when buffered output has drained after ndn_put has refused
+ * a message because of the output limit.
+ */
+typedef void (*ndn_output_drained_action)(struct ndn *h, void *data);
+
+size_t ndn_set_output_limit(struct ndn *h, size_t limit);
+int ndn_set_output_drained_action(struct ndn *h,
+                                  ndn_output_drained_action action,
+                                  void *data);
+
+#endif
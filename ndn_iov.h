@@ -0,0 +1,59 @@
+/**
+ * @file ndn_iov.h
+ * @brief Encoding and sending ContentObjects as pieces, without copying
+ *        the payload.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_IOV_DEFINED
+#define NDN_IOV_DEFINED
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+
+/**
+ * Number of pieces from ndn_encode_ContentObject_iov and
+ * ndn_sign_content_iov; size the iovec arrays passed to them with this.
+ */
+#define NDN_CONTENTOBJECT_IOV 3
+
+/**
+ * Most pieces that ndn_put_iov takes for one message
+ */
+#define NDN_PUT_IOV_MAX 16
+
+int ndn_encode_ContentObject_iov(struct ndn_charbuf *head,
+                                 struct iovec *iov,
+                                 const struct ndn_charbuf *Name,
+                                 const struct ndn_charbuf *SignedInfo,
+                                 const void *data,
+                                 size_t size,
+                                 const char *digest_algorithm,
+                                 const struct ndn_pkey *private_key);
+
+int ndn_sign_content_iov(struct ndn *h,
+                         struct ndn_charbuf *headbuf,
+                         struct iovec *iov,
+                         const struct ndn_charbuf *name_prefix,
+                         const struct ndn_signing_params *params,
+                         const void *data, size_t size);
+
+int ndn_put_iov(struct ndn *h, const struct iovec *iov, int iovcnt);
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * @file ndn_keys.h
+ * @brief Saving, loading and sharing the public keys a handle knows.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_KEYS_DEFINED
+#define NDN_KEYS_DEFINED
+
+#include <ndn/ndn.h>
+
+int ndn_save_keys(struct ndn *h, const char *path);
+int ndn_load_keys(struct ndn *h, const char *path);
+
+struct hashtb_shared;
+
+struct hashtb_shared *ndn_key_cache_create(void);
+struct hashtb_shared *ndn_set_key_cache(struct ndn *h,
+                                        struct hashtb_shared *cache);
+
+#endif
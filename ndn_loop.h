@@ -0,0 +1,59 @@
+/**
+ * @file ndn_loop.h
+ * @brief Serving many handles and application fds from one thread.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_LOOP_DEFINED
+#define NDN_LOOP_DEFINED
+
+#include <ndn/ndn.h>
+
+#ifdef __linux__
+/* The loop is built on epoll, so it is there only on Linux */
+
+/**
+ * Event loop serving many handles and application fds from one thread
+ */
+struct ndn_loop;
+
+/**
+ * Action for an application file descriptor registered with a ndn_loop
+ *
+ * Called with the epoll event bits (EPOLLIN, EPOLLOUT, ...) that were
+ * reported for fd.  The fd is registered edge-triggered, so the action
+ * should consume everything that is available.
+ */
+typedef void (*ndn_loop_fd_action)(struct ndn_loop *loop,
+                                   int fd, unsigned events, void *data);
+
+struct ndn_loop *ndn_loop_create(void);
+void ndn_loop_destroy(struct ndn_loop **loopp);
+
+int ndn_loop_add_handle(struct ndn_loop *loop, struct ndn *h);
+int ndn_loop_remove_handle(struct ndn_loop *loop, struct ndn *h);
+
+int ndn_loop_add_fd(struct ndn_loop *loop, int fd, unsigned events,
+                    ndn_loop_fd_action action, void *data);
+int ndn_loop_remove_fd(struct ndn_loop *loop, int fd);
+
+int ndn_loop_set_timeout(struct ndn_loop *loop, int timeout);
+int ndn_run_many(struct ndn_loop *loop, int timeout);
+
+#endif
+
+#endif
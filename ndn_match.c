@@ -186,7 +186,9 @@ ndn_excluded(const unsigned char *excl,
  *                              ndnd's content store).
  * @param pc                    Valid parse information may be provided to
  *                              speed things up. If NULL it will be
- *                              reconstructed internally.
+ *                              reconstructed internally.  It may be
+ *                              from ndn_parse_ContentObject_lazy, and
+ *                              is finished here only if need be.
  * @param interest_msg          ndnb-encoded Interest
  * @param interest_msg_size     its size in bytes
  * @param pi                    see _pc_
@@ -230,6 +232,11 @@ ndn_content_matches_interest(const unsigned char *content_object,
         if (res < 0) return(0);
         pi = &pi_store;
     }
+    /* the publisher digest is in SignedInfo, which may not be parsed yet */
+    if (pi->offset[NDN_PI_B_PublisherIDKeyDigest] !=
+          pi->offset[NDN_PI_E_PublisherIDKeyDigest] &&
+        ndn_parse_ContentObject_finish(content_object, content_object_size, pc) < 0)
+        return(0);
     if (!ndn_pubid_matches(content_object, pc, interest_msg, pi))
         return(0);
     ncomps = pc->name_ncomps + (implicit_content_digest ? 1 : 0);
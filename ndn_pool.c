@@ -0,0 +1,156 @@
+/**
+ * @file ndn_pool.c
+ * @brief Size-class pools for small, short-lived objects.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ndn_pool.h"
+
+/** Size classes are multiples of this; it is also the alignment. */
+#define POOL_GRAIN 16
+#define POOL_SLAB_SIZE 16384
+
+/*
+ * The slab header is padded to POOL_GRAIN so that the blocks carved
+ * after it stay aligned.
+ */
+union pool_slab {
+    union pool_slab *next;
+    unsigned char pad[POOL_GRAIN];
+};
+
+struct pool_free {
+    struct pool_free *next;
+};
+
+struct ndn_pool {
+    size_t max_size;            /* largest block size, rounded to grain */
+    size_t slab_size;           /* bytes in each slab after the header */
+    unsigned char *avail;       /* uncarved part of the newest slab */
+    size_t n_avail;
+    union pool_slab *slabs;     /* all slabs, newest first */
+    struct pool_free *free[1];  /* free list per class (actually more) */
+};
+
+#define POOL_CLASS(size) (((size) + POOL_GRAIN - 1) / POOL_GRAIN - 1)
+
+/**
+ * Create a pool for blocks of up to max_size bytes.
+ * @returns the new pool, or NULL for error.
+ */
+struct ndn_pool *
+ndn_pool_create(size_t max_size)
+{
+    struct ndn_pool *pool;
+    size_t n_classes;
+
+    if (max_size < POOL_GRAIN)
+        max_size = POOL_GRAIN;
+    n_classes = POOL_CLASS(max_size) + 1;
+    pool = calloc(1, sizeof(*pool) + (n_classes - 1) * sizeof(pool->free[0]));
+    if (pool == NULL)
+        return(NULL);
+    pool->max_size = n_classes * POOL_GRAIN;
+    pool->slab_size = POOL_SLAB_SIZE;
+    while (pool->slab_size < 8 * pool->max_size)
+        pool->slab_size *= 2;
+    return(pool);
+}
+
+/**
+ * Destroy a pool, along with every block it has handed out.
+ */
+void
+ndn_pool_destroy(struct ndn_pool **poolp)
+{
+    struct ndn_pool *pool = *poolp;
+    union pool_slab *s;
+
+    if (pool == NULL)
+        return;
+    while (pool->slabs != NULL) {
+        s = pool->slabs;
+        pool->slabs = s->next;
+        free(s);
+    }
+    free(pool);
+    *poolp = NULL;
+}
+
+/**
+ * Allocate a zeroed block of size bytes.
+ * @returns the block, or NULL for error.
+ */
+void *
+ndn_pool_alloc(struct ndn_pool *pool, size_t size)
+{
+    struct pool_free *p;
+    union pool_slab *s;
+    size_t k;
+
+    if (size == 0)
+        size = 1;
+    if (size > pool->max_size)
+        return(calloc(1, size));
+    k = POOL_CLASS(size);
+    p = pool->free[k];
+    if (p != NULL)
+        pool->free[k] = p->next;
+    else {
+        size = (k + 1) * POOL_GRAIN;
+        if (pool->n_avail < size) {
+            s = malloc(sizeof(*s) + pool->slab_size);
+            if (s == NULL)
+                return(NULL);
+            s->next = pool->slabs;
+            pool->slabs = s;
+            pool->avail = (unsigned char *)(s + 1);
+            pool->n_avail = pool->slab_size;
+        }
+        p = (struct pool_free *)pool->avail;
+        pool->avail += size;
+        pool->n_avail -= size;
+    }
+    memset(p, 0, size);
+    return(p);
+}
+
+/**
+ * Return a block to the pool.
+ * @param size must be the size that was passed to ndn_pool_alloc.
+ */
+void
+ndn_pool_free(struct ndn_pool *pool, void *p, size_t size)
+{
+    struct pool_free *f = p;
+    size_t k;
+
+    if (p == NULL)
+        return;
+    if (size == 0)
+        size = 1;
+    if (size > pool->max_size) {
+        free(p);
+        return;
+    }
+    k = POOL_CLASS(size);
+    f->next = pool->free[k];
+    pool->free[k] = f;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file ndn_pool.h
+ * @brief Size-class pools for small, short-lived objects.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_POOL_DEFINED
+#define NDN_POOL_DEFINED
+
+#include <stddef.h>
+
+/**
+ * A pool hands out blocks of up to max_size bytes, carved from large
+ * slabs and recycled through a free list per size class, so that both
+ * allocation and release take constant time.  Larger requests go to
+ * malloc.  Slabs are returned to the system only when the pool is
+ * destroyed.
+ */
+struct ndn_pool;
+
+struct ndn_pool *ndn_pool_create(size_t max_size);
+void ndn_pool_destroy(struct ndn_pool **poolp);
+void *ndn_pool_alloc(struct ndn_pool *pool, size_t size);
+void ndn_pool_free(struct ndn_pool *pool, void *p, size_t size);
+
+#endif
@@ -29,6 +29,8 @@
 #include <ndn/charbuf.h>
 #include <ndn/reg_mgmt.h>
 
+#include "ndn_coding.h"
+
 /*
  * 从字符串p中,parse得到prefix
  */
@@ -120,8 +122,8 @@ ndnb_append_forwarding_entry(struct ndn_charbuf *c,
     int res;
     res = ndnb_element_begin(c, NDN_DTAG_ForwardingEntry);
     if (fe->action != NULL)
-        res |= ndnb_tagged_putf(c, NDN_DTAG_Action, "%s",
-                                   fe->action);
+        res |= ndnb_append_tagged_udata(c, NDN_DTAG_Action,
+                                        fe->action, strlen(fe->action));
     if (fe->name_prefix != NULL && fe->name_prefix->length > 0)
         res |= ndn_charbuf_append(c, fe->name_prefix->buf,
                                      fe->name_prefix->length);
@@ -129,14 +131,13 @@ ndnb_append_forwarding_entry(struct ndn_charbuf *c,
         res |= ndnb_append_tagged_blob(c, NDN_DTAG_PublisherPublicKeyDigest,
                                           fe->ndnd_id, fe->ndnd_id_size);
     if (fe->faceid != ~0)
-        res |= ndnb_tagged_putf(c, NDN_DTAG_FaceID, "%u",
-                                   fe->faceid);
+        res |= ndnb_append_tagged_number(c, NDN_DTAG_FaceID, fe->faceid);
     if (fe->flags >= 0)
-        res |= ndnb_tagged_putf(c, NDN_DTAG_ForwardingFlags, "%d",
-                                   fe->flags);
+        res |= ndnb_append_tagged_number(c, NDN_DTAG_ForwardingFlags,
+                                         fe->flags);
     if (fe->lifetime >= 0)
-        res |= ndnb_tagged_putf(c, NDN_DTAG_FreshnessSeconds, "%d",
-                                   fe->lifetime);
+        res |= ndnb_append_tagged_number(c, NDN_DTAG_FreshnessSeconds,
+                                         fe->lifetime);
     res |= ndnb_element_end(c);
     return(res);
 }
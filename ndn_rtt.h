@@ -0,0 +1,48 @@
+/**
+ * @file ndn_rtt.h
+ * @brief Round-trip estimation and retransmission of interests.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_RTT_DEFINED
+#define NDN_RTT_DEFINED
+
+#include <stdint.h>
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+
+/**
+ * Round-trip estimate and retransmission counters, kept for each name
+ * prefix that has had interests expressed under it and for the handle
+ * as a whole.  See ndn_get_rtt_stats().
+ */
+struct ndn_rtt_stats {
+    int srtt_us;                /**< smoothed round-trip time */
+    int rttvar_us;              /**< smoothed mean deviation */
+    int rto_us;                 /**< retransmission timeout */
+    uintmax_t samples;          /**< round trips measured */
+    uintmax_t retransmits;      /**< interests sent again after the RTO */
+    uintmax_t timeouts;         /**< interests that reached their lifetime */
+};
+
+int ndn_set_interest_retransmit(struct ndn *h, int enabled);
+
+int ndn_get_rtt_stats(struct ndn *h,
+                      const struct ndn_charbuf *prefix,
+                      struct ndn_rtt_stats *stats);
+
+#endif
@@ -0,0 +1,621 @@
+/**
+ * @file ndn_segfetch.c
+ * @brief Windowed retrieval of segmented content.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * Based on the CCNx C Library by PARC.
+ * Copyright (C) 2009-2013 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+#include <ndn/coding.h>
+#include <ndn/schedule.h>
+
+#include "ndn_coding.h"
+#include "ndn_rtt.h"
+#include "ndn_segfetch.h"
+
+/**
+ * Upper bound on segments between the delivery point and the highest
+ * segment asked for; also bounds the congestion window.
+ * Must be a power of 2.
+ */
+#ifndef NDN_SEGFETCH_MAX_WINDOW
+#define NDN_SEGFETCH_MAX_WINDOW 256
+#endif
+
+#define SEGFETCH_INITIAL_SSTHRESH 64
+#define SEGFETCH_INITIAL_RTO_US 1000000
+#define SEGFETCH_MIN_RTO_US 20000
+#define SEGFETCH_MAX_RTO_US 4000000
+
+struct segfetch;
+
+/**
+ * Per-segment closure.
+ *
+ * Retransmission leaves earlier interests pending in the handle, so the
+ * closure may be referenced by several of them; it is freed on the last
+ * NDN_UPCALL_FINAL.  The fetch holds one reference while the segment
+ * is in its window, and clears sf when it lets go.
+ */
+struct segfetch_item {
+    struct ndn_closure closure;
+    struct segfetch *sf;
+    uintmax_t seg;
+    struct timeval sent;                /**< when last expressed */
+    int retries;
+    struct ndn_scheduled_event *ev;     /**< retransmission timer */
+    struct ndn_charbuf *value;          /**< held for in-order delivery */
+    int final;
+};
+
+/**
+ * State of one call to ndn_segfetch()
+ */
+struct segfetch {
+    struct ndn *h;
+    struct ndn_schedule *sched;
+    struct ndn_charbuf *name;           /**< versioned prefix */
+    struct ndn_charbuf *templ;
+    struct ndn_charbuf *segname;        /**< scratch */
+    ndn_segfetch_action action;
+    void *data;
+    int get_flags;
+    int done;                           /**< 1 success, -1 failure */
+    uintmax_t next_deliver;
+    uintmax_t next_issue;
+    uintmax_t final;
+    int have_final;
+    int n_inflight;
+    int cwnd;
+    int cwnd_acked;                     /**< acks toward the next increase */
+    int ssthresh;
+    uintmax_t recover;                  /**< no further cut below this */
+    int srtt_us;                        /**< 0 until the first sample */
+    int rttvar_us;
+    int rto_us;
+    struct timeval last_progress;
+    struct ndn_segfetch_stats stats;
+    struct segfetch_item *ring[NDN_SEGFETCH_MAX_WINDOW];
+};
+
+#define SEGFETCH_SLOT(sf, s) ((sf)->ring[(s) & (NDN_SEGFETCH_MAX_WINDOW - 1)])
+
+static int
+segfetch_micros_since(const struct timeval *then)
+{
+    struct timeval now;
+    intmax_t us;
+
+    gettimeofday(&now, NULL);
+    us = (intmax_t)(now.tv_sec - then->tv_sec) * 1000000 +
+         (now.tv_usec - then->tv_usec);
+    if (us < 0)
+        return(0);
+    if (us > INT_MAX)
+        return(INT_MAX);
+    return(us);
+}
+
+static void
+segfetch_gettime(const struct ndn_gettime *self, struct ndn_timeval *result)
+{
+    struct timeval now = {0};
+    gettimeofday(&now, 0);
+    result->s = now.tv_sec;
+    result->micros = now.tv_usec;
+}
+
+static const struct ndn_gettime segfetch_ticker = {
+    "segf", &segfetch_gettime, 1000000, NULL
+};
+
+/**
+ * Fold a round-trip sample into the estimate (Jacobson/Karels) and
+ * recompute the retransmission timeout.
+ */
+static void
+segfetch_rtt_sample(struct segfetch *sf, int rtt_us)
+{
+    int err;
+    int rto;
+
+    if (sf->srtt_us == 0) {
+        sf->srtt_us = rtt_us > 0 ? rtt_us : 1;
+        sf->rttvar_us = rtt_us / 2;
+    }
+    else {
+        err = rtt_us - sf->srtt_us;
+        sf->srtt_us += err / 8;
+        if (sf->srtt_us <= 0)
+            sf->srtt_us = 1;
+        if (err < 0)
+            err = -err;
+        sf->rttvar_us += (err - sf->rttvar_us) / 4;
+    }
+    rto = sf->srtt_us + 4 * sf->rttvar_us;
+    if (rto < SEGFETCH_MIN_RTO_US)
+        rto = SEGFETCH_MIN_RTO_US;
+    if (rto > SEGFETCH_MAX_RTO_US)
+        rto = SEGFETCH_MAX_RTO_US;
+    sf->rto_us = rto;
+}
+
+/**
+ * Retransmission timeout for an item, backed off by its retry count
+ */
+static int
+segfetch_item_rto(struct segfetch *sf, struct segfetch_item *item)
+{
+    int rto = sf->rto_us;
+    int i;
+
+    for (i = 0; i < item->retries && rto < SEGFETCH_MAX_RTO_US; i++)
+        rto *= 2;
+    if (rto > SEGFETCH_MAX_RTO_US)
+        rto = SEGFETCH_MAX_RTO_US;
+    return(rto);
+}
+
+/**
+ * Drop the fetch's reference to an item, which leaves its window slot
+ */
+static void
+segfetch_release(struct segfetch *sf, struct segfetch_item *item)
+{
+    if (item->sf == NULL)
+        return;
+    item->sf = NULL;
+    if (SEGFETCH_SLOT(sf, item->seg) == item)
+        SEGFETCH_SLOT(sf, item->seg) = NULL;
+    if (item->ev != NULL) {
+        ndn_schedule_cancel(sf->sched, item->ev);
+        item->ev = NULL;
+    }
+    ndn_charbuf_destroy(&item->value);
+    if (--(item->closure.refcount) == 0)
+        free(item);
+}
+
+static void
+segfetch_finish(struct segfetch *sf, int done)
+{
+    if (sf->done == 0) {
+        sf->done = done;
+        ndn_set_run_timeout(sf->h, 0);
+    }
+}
+
+/**
+ * Express the interest for an item's segment
+ *
+ * The handle's own retransmission is kept off for these interests, since
+ * segfetch_timeout resends them; otherwise each loss would be resent
+ * twice, and Karn's rule could not be applied to resends we never saw.
+ */
+static int
+segfetch_express(struct segfetch *sf, struct segfetch_item *item)
+{
+    int res;
+    int retransmit;
+
+    sf->segname->length = 0;
+    ndn_charbuf_append_charbuf(sf->segname, sf->name);
+    res = ndn_name_append_numeric(sf->segname, NDN_MARKER_SEQNUM, item->seg);
+    if (res >= 0) {
+        retransmit = ndn_set_interest_retransmit(sf->h, 0);
+        res = ndn_express_interest(sf->h, sf->segname,
+                                   &item->closure, sf->templ);
+        ndn_set_interest_retransmit(sf->h, retransmit);
+    }
+    if (res < 0)
+        return(-1);
+    gettimeofday(&item->sent, NULL);
+    sf->stats.interests++;
+    return(0);
+}
+
+static enum ndn_upcall_res
+segfetch_incoming_content(struct ndn_closure *selfp,
+                          enum ndn_upcall_kind kind,
+                          struct ndn_upcall_info *info);
+static int
+segfetch_timeout(struct ndn_schedule *sched,
+                 void *clienth,
+                 struct ndn_scheduled_event *ev,
+                 int flags);
+
+/**
+ * Ask for more segments, as long as the congestion window allows
+ */
+static void
+segfetch_issue(struct segfetch *sf)
+{
+    struct segfetch_item *item;
+
+    while (sf->done == 0 && sf->n_inflight < sf->cwnd &&
+           sf->next_issue - sf->next_deliver < NDN_SEGFETCH_MAX_WINDOW &&
+           (!sf->have_final || sf->next_issue <= sf->final)) {
+        item = calloc(1, sizeof(*item));
+        if (item == NULL) {
+            segfetch_finish(sf, -1);
+            return;
+        }
+        item->closure.p = &segfetch_incoming_content;
+        item->closure.data = item;
+        item->closure.refcount = 1; /* ours */
+        item->sf = sf;
+        item->seg = sf->next_issue++;
+        SEGFETCH_SLOT(sf, item->seg) = item;
+        sf->n_inflight++;
+        if (segfetch_express(sf, item) < 0) {
+            segfetch_finish(sf, -1);
+            return;
+        }
+        item->ev = ndn_schedule_event(sf->sched, sf->rto_us,
+                                      &segfetch_timeout, item, 0);
+        if (item->ev == NULL) {
+            segfetch_finish(sf, -1);
+            return;
+        }
+    }
+}
+
+/**
+ * Hand over every segment that is now in order
+ */
+static void
+segfetch_deliver(struct segfetch *sf)
+{
+    struct segfetch_item *item;
+    int res;
+
+    for (;;) {
+        item = SEGFETCH_SLOT(sf, sf->next_deliver);
+        if (item == NULL || item->seg != sf->next_deliver ||
+            item->value == NULL)
+            break;
+        res = (sf->action)(sf->data, item->seg,
+                           item->value->buf, item->value->length,
+                           item->final);
+        sf->stats.segments++;
+        sf->stats.bytes += item->value->length;
+        sf->next_deliver++;
+        segfetch_release(sf, item);
+        if (res < 0) {
+            segfetch_finish(sf, -1);
+            return;
+        }
+        if (sf->have_final && sf->next_deliver > sf->final) {
+            segfetch_finish(sf, 1);
+            return;
+        }
+    }
+}
+
+/**
+ * Extract the segment number carried by FinalBlockID, if present
+ * @returns 1 if found, 0 if absent, -1 if it is not a segment number.
+ */
+static int
+segfetch_final_segment(const unsigned char *ndnb,
+                       const struct ndn_parsed_ContentObject *pco,
+                       uintmax_t *segp)
+{
+    const unsigned char *p = NULL;
+    size_t size = 0;
+    uintmax_t v = 0;
+    size_t i;
+
+    if (pco->offset[NDN_PCO_B_FinalBlockID] ==
+        pco->offset[NDN_PCO_E_FinalBlockID])
+        return(0);
+    if (ndn_ref_tagged_BLOB(NDN_DTAG_FinalBlockID, ndnb,
+                            pco->offset[NDN_PCO_B_FinalBlockID],
+                            pco->offset[NDN_PCO_E_FinalBlockID],
+                            &p, &size) < 0)
+        return(-1);
+    if (size < 1 || size > 1 + sizeof(v) || p[0] != NDN_MARKER_SEQNUM)
+        return(-1);
+    for (i = 1; i < size; i++)
+        v = (v << 8) + p[i];
+    *segp = v;
+    return(1);
+}
+
+/**
+ * Upcall for segment interests
+ */
+static enum ndn_upcall_res
+segfetch_incoming_content(struct ndn_closure *selfp,
+                          enum ndn_upcall_kind kind,
+                          struct ndn_upcall_info *info)
+{
+    struct segfetch_item *item = selfp->data;
+    struct segfetch *sf = item->sf;
+    const unsigned char *value = NULL;
+    size_t size = 0;
+    uintmax_t final;
+
+    if (kind == NDN_UPCALL_FINAL) {
+        if (selfp != &item->closure)
+            abort();
+        ndn_charbuf_destroy(&item->value);
+        free(item);
+        return(NDN_UPCALL_RESULT_OK);
+    }
+    if (sf == NULL || sf->done != 0)
+        return(NDN_UPCALL_RESULT_OK);
+    /* Our own timer decides when to ask again */
+    if (kind == NDN_UPCALL_INTEREST_TIMED_OUT)
+        return(NDN_UPCALL_RESULT_OK);
+    if (kind == NDN_UPCALL_CONTENT_UNVERIFIED) {
+        if ((sf->get_flags & NDN_GET_NOKEYWAIT) == 0)
+            return(NDN_UPCALL_RESULT_VERIFY);
+    }
+    else if (kind == NDN_UPCALL_CONTENT_KEYMISSING) {
+        if ((sf->get_flags & NDN_GET_NOKEYWAIT) == 0)
+            return(NDN_UPCALL_RESULT_FETCHKEY);
+    }
+    else if (kind != NDN_UPCALL_CONTENT && kind != NDN_UPCALL_CONTENT_RAW) {
+        segfetch_finish(sf, -1);
+        return(NDN_UPCALL_RESULT_ERR);
+    }
+    if (item->value != NULL) {
+        sf->stats.duplicates++;
+        return(NDN_UPCALL_RESULT_OK);
+    }
+    if (ndn_content_get_value(info->content_ndnb, info->pco->offset[NDN_PCO_E],
+                              info->pco, &value, &size) < 0) {
+        segfetch_finish(sf, -1);
+        return(NDN_UPCALL_RESULT_ERR);
+    }
+    item->value = ndn_charbuf_create();
+    if (item->value == NULL ||
+        ndn_charbuf_append(item->value, value, size) < 0) {
+        segfetch_finish(sf, -1);
+        return(NDN_UPCALL_RESULT_OK);
+    }
+    if (item->ev != NULL) {
+        ndn_schedule_cancel(sf->sched, item->ev);
+        item->ev = NULL;
+    }
+    sf->n_inflight--;
+    gettimeofday(&sf->last_progress, NULL);
+    /* Karn: a retransmitted segment gives an ambiguous sample */
+    if (item->retries == 0)
+        segfetch_rtt_sample(sf, segfetch_micros_since(&item->sent));
+    /* Additive increase, after slow start */
+    if (sf->cwnd < sf->ssthresh)
+        sf->cwnd++;
+    else if (++(sf->cwnd_acked) >= sf->cwnd) {
+        sf->cwnd_acked = 0;
+        sf->cwnd++;
+    }
+    if (sf->cwnd > NDN_SEGFETCH_MAX_WINDOW)
+        sf->cwnd = NDN_SEGFETCH_MAX_WINDOW;
+    if (sf->cwnd > sf->stats.max_cwnd)
+        sf->stats.max_cwnd = sf->cwnd;
+    if (ndn_is_final_block(info) == 1) {
+        item->final = 1;
+        if (!sf->have_final || item->seg < sf->final)
+            sf->final = item->seg;
+        sf->have_final = 1;
+    }
+    else if (!sf->have_final &&
+             segfetch_final_segment(info->content_ndnb, info->pco, &final) == 1 &&
+             final >= item->seg) {
+        sf->final = final;
+        sf->have_final = 1;
+    }
+    segfetch_deliver(sf);
+    segfetch_issue(sf);
+    return(NDN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Scheduled action for the retransmission timeout of a segment
+ */
+static int
+segfetch_timeout(struct ndn_schedule *sched,
+                 void *clienth,
+                 struct ndn_scheduled_event *ev,
+                 int flags)
+{
+    struct segfetch_item *item = ev->evdata;
+    struct segfetch *sf = item->sf;
+
+    if ((flags & NDN_SCHEDULE_CANCEL) != 0)
+        return(0);
+    if (sf->have_final && item->seg > sf->final) {
+        /* Asked for past the end; just forget it */
+        sf->n_inflight--;
+        item->ev = NULL;
+        segfetch_release(sf, item);
+        segfetch_issue(sf);
+        return(0);
+    }
+    /* Multiplicative decrease, at most once per window of losses */
+    if (item->seg >= sf->recover) {
+        sf->ssthresh = sf->cwnd / 2;
+        if (sf->ssthresh < 1)
+            sf->ssthresh = 1;
+        sf->cwnd = sf->ssthresh;
+        sf->cwnd_acked = 0;
+        sf->recover = sf->next_issue;
+    }
+    item->retries++;
+    sf->stats.retransmits++;
+    if (segfetch_express(sf, item) < 0) {
+        item->ev = NULL;
+        segfetch_finish(sf, -1);
+        return(0);
+    }
+    return(segfetch_item_rto(sf, item));
+}
+
+/**
+ * Fetch a segmented stream, keeping a window of interests outstanding.
+ *
+ * Segment n is named by name plus a SEQNUM component holding n, starting
+ * at 0, and the stream ends with the segment named by FinalBlockID.
+ * The window grows additively as segments arrive (after a slow start)
+ * and is halved when a retransmission timeout fires; the timeout tracks
+ * the measured round-trip time.  Segments are handed to action strictly
+ * in order.
+ *
+ * This runs the handle, and so must not be called from an upcall.
+ * If the handle has no schedule, one is attached for the duration.
+ *
+ * @param h is the ndn handle.
+ * @param name is the ndnb-encoded prefix of the segments; it is not changed.
+ * @param versioning_flags, if nonzero, are passed to ndn_resolve_version
+ *        to pick the version to fetch (e.g. NDN_V_HIGHEST).
+ * @param timeout_ms gives up after this long with no segment arriving.
+ * @param get_flags may contain NDN_GET_NOKEYWAIT.
+ * @param action receives the segments; data is passed along to it.
+ * @param stats, if not NULL, is filled in at the end.
+ * @returns 0 when the final segment has been delivered, otherwise -1.
+ */
+int
+ndn_segfetch(struct ndn *h, const struct ndn_charbuf *name,
+             int versioning_flags, int timeout_ms, int get_flags,
+             ndn_segfetch_action action, void *data,
+             struct ndn_segfetch_stats *stats)
+{
+    struct segfetch *sf = NULL;
+    struct ndn_schedule *sched = NULL;
+    uintmax_t s;
+    int idle;
+    int res = -1;
+
+    if (h == NULL || name == NULL || action == NULL || timeout_ms <= 0) {
+        ndn_seterror(h, EINVAL);
+        return(-1);
+    }
+    sf = calloc(1, sizeof(*sf));
+    if (sf == NULL) {
+        ndn_seterror(h, ENOMEM);
+        return(-1);
+    }
+    sf->h = h;
+    sf->action = action;
+    sf->data = data;
+    sf->get_flags = get_flags;
+    sf->cwnd = 1;
+    sf->ssthresh = SEGFETCH_INITIAL_SSTHRESH;
+    sf->rto_us = SEGFETCH_INITIAL_RTO_US;
+    sf->stats.max_cwnd = 1;
+    sf->name = ndn_charbuf_create();
+    sf->segname = ndn_charbuf_create();
+    sf->templ = ndn_charbuf_create();
+    if (sf->name == NULL || sf->segname == NULL || sf->templ == NULL)
+        goto Finish;
+    ndn_charbuf_append_charbuf(sf->name, name);
+    if (versioning_flags != 0 &&
+        ndn_resolve_version(h, sf->name, versioning_flags, timeout_ms) < 0)
+        goto Finish;
+    /* Exact match: only the implicit digest may follow the segment */
+    ndn_charbuf_append_tt(sf->templ, NDN_DTAG_Interest, NDN_DTAG);
+    ndn_charbuf_append_tt(sf->templ, NDN_DTAG_Name, NDN_DTAG);
+    ndn_charbuf_append_closer(sf->templ); /* </Name> */
+    ndnb_append_tagged_number(sf->templ, NDN_DTAG_MaxSuffixComponents, 1);
+    ndn_charbuf_append_closer(sf->templ); /* </Interest> */
+    sf->sched = ndn_get_schedule(h);
+    if (sf->sched == NULL) {
+        sched = ndn_schedule_create(h, &segfetch_ticker);
+        if (sched == NULL)
+            goto Finish;
+        ndn_set_schedule(h, sched);
+        sf->sched = sched;
+    }
+    gettimeofday(&sf->last_progress, NULL);
+    segfetch_issue(sf);
+    while (sf->done == 0) {
+        idle = segfetch_micros_since(&sf->last_progress) / 1000;
+        if (idle >= timeout_ms) {
+            ndn_seterror(h, ETIMEDOUT);
+            break;
+        }
+        if (ndn_run(h, timeout_ms - idle) < 0)
+            break;
+    }
+    if (sf->done == 1)
+        res = 0;
+Finish:
+    for (s = sf->next_deliver; s != sf->next_issue; s++) {
+        if (SEGFETCH_SLOT(sf, s) != NULL)
+            segfetch_release(sf, SEGFETCH_SLOT(sf, s));
+    }
+    if (sched != NULL) {
+        ndn_set_schedule(h, NULL);
+        ndn_schedule_destroy(&sched);
+    }
+    sf->stats.cwnd = sf->cwnd;
+    sf->stats.srtt_us = sf->srtt_us;
+    sf->stats.rto_us = sf->rto_us;
+    if (stats != NULL)
+        *stats = sf->stats;
+    ndn_charbuf_destroy(&sf->name);
+    ndn_charbuf_destroy(&sf->segname);
+    ndn_charbuf_destroy(&sf->templ);
+    free(sf);
+    return(res);
+}
+
+static int
+segfetch_write_fd(void *data, uintmax_t segment,
+                  const unsigned char *p, size_t size, int final)
+{
+    int fd = *(int *)data;
+    ssize_t res;
+
+    while (size > 0) {
+        res = write(fd, p, size);
+        if (res < 0) {
+            if (errno == EINTR)
+                continue;
+            return(-1);
+        }
+        p += res;
+        size -= res;
+    }
+    return(0);
+}
+
+/**
+ * Fetch a segmented stream and write it to a file descriptor
+ *
+ * Arguments and result are as for ndn_segfetch().
+ */
+int
+ndn_segfetch_fd(struct ndn *h, const struct ndn_charbuf *name,
+                int versioning_flags, int timeout_ms, int get_flags,
+                int fd, struct ndn_segfetch_stats *stats)
+{
+    return(ndn_segfetch(h, name, versioning_flags, timeout_ms, get_flags,
+                        &segfetch_write_fd, &fd, stats));
+}
@@ -0,0 +1,67 @@
+/**
+ * @file ndn_segfetch.h
+ * @brief Windowed retrieval of segmented content.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * Based on the CCNx C Library by PARC.
+ * Copyright (C) 2009-2013 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_SEGFETCH_DEFINED
+#define NDN_SEGFETCH_DEFINED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ndn/ndn.h>
+#include <ndn/charbuf.h>
+
+/**
+ * Counters describing a finished (or abandoned) segmented fetch.
+ */
+struct ndn_segfetch_stats {
+    uintmax_t segments;         /**< segments delivered in order */
+    uintmax_t bytes;            /**< payload bytes delivered */
+    uintmax_t interests;        /**< segment interests expressed */
+    uintmax_t retransmits;      /**< of those, sent after an RTO expired */
+    uintmax_t duplicates;       /**< content that arrived for a done segment */
+    int cwnd;                   /**< congestion window at the end */
+    int max_cwnd;               /**< largest congestion window reached */
+    int srtt_us;                /**< smoothed round-trip time at the end */
+    int rto_us;                 /**< retransmission timeout at the end */
+};
+
+/**
+ * Receives segment payloads, strictly in segment order.
+ * @param data is the client data passed to ndn_segfetch().
+ * @param segment is the segment number.
+ * @param final is nonzero for the segment named by FinalBlockID.
+ * @returns 0 to continue, or -1 to abandon the fetch.
+ */
+typedef int (*ndn_segfetch_action)(void *data, uintmax_t segment,
+                                   const unsigned char *p, size_t size,
+                                   int final);
+
+int ndn_segfetch(struct ndn *h, const struct ndn_charbuf *name,
+                 int versioning_flags, int timeout_ms, int get_flags,
+                 ndn_segfetch_action action, void *data,
+                 struct ndn_segfetch_stats *stats);
+
+int ndn_segfetch_fd(struct ndn *h, const struct ndn_charbuf *name,
+                    int versioning_flags, int timeout_ms, int get_flags,
+                    int fd, struct ndn_segfetch_stats *stats);
+
+#endif
@@ -31,6 +31,8 @@
 #include <ndn/signing.h>
 #include <ndn/random.h>
 
+#include "ndn_signing.h"
+
 struct ndn_sigc {
     EVP_MD_CTX context;
 };
@@ -198,6 +200,101 @@ ndn_sigc_signature_max_size(struct ndn_sigc *ctx, const struct ndn_pkey *priv_ke
     return (EVP_PKEY_size((EVP_PKEY *)priv_key));
 }
 
+/*
+ * The digest that the signature of a ContentObject was made with
+ */
+static const EVP_MD *
+md_from_signature(const unsigned char *msg,
+                  const struct ndn_parsed_ContentObject *co,
+                  const struct ndn_pkey *verification_pubkey)
+{
+    const unsigned char *digest_algorithm = NULL;
+    size_t digest_algorithm_size;
+    int res;
+
+    if (co->offset[NDN_PCO_B_DigestAlgorithm] == co->offset[NDN_PCO_E_DigestAlgorithm]) {
+        digest_algorithm = (const unsigned char *)NDN_SIGNING_DEFAULT_DIGEST_ALGORITHM;
+    }
+    else {
+        /* figure out what algorithm the OID represents */
+        res = ndn_ref_tagged_string(NDN_DTAG_DigestAlgorithm, msg,
+                                  co->offset[NDN_PCO_B_DigestAlgorithm],
+                                  co->offset[NDN_PCO_E_DigestAlgorithm],
+                                  &digest_algorithm,
+                                  &digest_algorithm_size);
+        if (res < 0)
+            return (NULL);
+        /* NOTE: since the element closer is a 0, and the element is well formed,
+         * the string will be null terminated
+         */
+    }
+    return (md_from_digest_and_pkey((const char *)digest_algorithm, verification_pubkey));
+}
+
+/**
+ * Start verifying the signature of a ContentObject piecewise.
+ *
+ * The signed part, from the start of the Name through the end of the
+ * Content, is then fed to ndn_sigc_verify_update() as it arrives, so
+ * that the content need never be held in memory all at once.
+ * @param msg needs to hold the ContentObject only through its SignedInfo;
+ *        co must be its parse, and both must stay put until
+ *        ndn_sigc_verify_final().
+ * @returns 0 for success, or -1 if the signature cannot be checked
+ *          this way, which includes those that carry a Witness.
+ */
+int
+ndn_sigc_verify_init(struct ndn_sigc *ctx,
+                     const unsigned char *msg,
+                     const struct ndn_parsed_ContentObject *co,
+                     const struct ndn_pkey *verification_pubkey)
+{
+    const EVP_MD *digest;
+
+    if (co->offset[NDN_PCO_B_Witness] != co->offset[NDN_PCO_E_Witness])
+        return (-1);
+    digest = md_from_signature(msg, co, verification_pubkey);
+    if (digest == NULL)
+        return (-1);
+    EVP_MD_CTX_init(&ctx->context);
+    if (0 == EVP_VerifyInit_ex(&ctx->context, digest, NULL))
+        return (-1);
+    return (0);
+}
+
+int
+ndn_sigc_verify_update(struct ndn_sigc *ctx, const void *data, size_t size)
+{
+    if (0 == EVP_VerifyUpdate(&ctx->context, data, size))
+        return (-1);
+    return (0);
+}
+
+/**
+ * Finish verifying a signature started with ndn_sigc_verify_init().
+ * @returns 1 if the signature is good, 0 if it is bad, -1 for error.
+ */
+int
+ndn_sigc_verify_final(struct ndn_sigc *ctx,
+                      const unsigned char *msg,
+                      const struct ndn_parsed_ContentObject *co,
+                      const struct ndn_pkey *verification_pubkey)
+{
+    const unsigned char *signature_bits = NULL;
+    size_t signature_bits_size = 0;
+    int res;
+
+    res = ndn_ref_tagged_BLOB(NDN_DTAG_SignatureBits, msg,
+                              co->offset[NDN_PCO_B_SignatureBits],
+                              co->offset[NDN_PCO_E_SignatureBits],
+                              &signature_bits,
+                              &signature_bits_size);
+    if (res < 0)
+        return (-1);
+    return (EVP_VerifyFinal(&ctx->context, signature_bits, signature_bits_size,
+                            (EVP_PKEY *)verification_pubkey));
+}
+
 #define is_left(x) (0 == (x & 1))
 #define node_lr(x) (x & 1)
 #define sibling_of(x) (x ^ 1)
@@ -302,8 +399,6 @@ int ndn_verify_signature(const unsigned char *msg,
     size_t signature_bits_size = 0;
     const unsigned char *witness = NULL;
     size_t witness_size = 0;
-    const unsigned char *digest_algorithm = NULL;
-    size_t digest_algorithm_size;
 
     EVP_PKEY *pkey = (EVP_PKEY *)verification_pubkey;
 
@@ -315,23 +410,9 @@ int ndn_verify_signature(const unsigned char *msg,
     if (res < 0)
         return (-1);
 
-    if (co->offset[NDN_PCO_B_DigestAlgorithm] == co->offset[NDN_PCO_E_DigestAlgorithm]) {
-        digest_algorithm = (const unsigned char *)NDN_SIGNING_DEFAULT_DIGEST_ALGORITHM;
-    }
-    else {
-        /* figure out what algorithm the OID represents */
-        res = ndn_ref_tagged_string(NDN_DTAG_DigestAlgorithm, msg,
-                                  co->offset[NDN_PCO_B_DigestAlgorithm],
-                                  co->offset[NDN_PCO_E_DigestAlgorithm],
-                                  &digest_algorithm,
-                                  &digest_algorithm_size);
-        if (res < 0)
-            return (-1);
-        /* NOTE: since the element closer is a 0, and the element is well formed,
-         * the string will be null terminated
-         */
-    }
-    digest = md_from_digest_and_pkey((const char *)digest_algorithm, verification_pubkey);
+    digest = md_from_signature(msg, co, verification_pubkey);
+    if (digest == NULL)
+        return (-1);
     EVP_MD_CTX_init(ver_ctx);
     res = EVP_VerifyInit_ex(ver_ctx, digest, NULL);
     if (!res) {
@@ -0,0 +1,40 @@
+/**
+ * @file ndn_signing.h
+ * @brief Verifying a signature as the signed part arrives.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef NDN_SIGNING_EXT_DEFINED
+#define NDN_SIGNING_EXT_DEFINED
+
+#include <stddef.h>
+#include <ndn/ndn.h>
+#include <ndn/signing.h>
+
+int ndn_sigc_verify_init(struct ndn_sigc *ctx,
+                         const unsigned char *msg,
+                         const struct ndn_parsed_ContentObject *co,
+                         const struct ndn_pkey *verification_pubkey);
+int ndn_sigc_verify_update(struct ndn_sigc *ctx,
+                           const void *data, size_t size);
+int ndn_sigc_verify_final(struct ndn_sigc *ctx,
+                          const unsigned char *msg,
+                          const struct ndn_parsed_ContentObject *co,
+                          const struct ndn_pkey *verification_pubkey);
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file ndn_stream.h
+ * @brief Streaming delivery of large ContentObject payloads.
+ *
+ * Part of the NDNx C Library.
+ *
+ * Portions Copyright (C) 2013 Regents of the University of California.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef NDN_STREAM_DEFINED
+#define NDN_STREAM_DEFINED
+
+#include <stddef.h>
+#include <ndn/ndn.h>
+#include <ndn/indexbuf.h>
+
+/**
+ * What a content sink is being told.
+ */
+enum ndn_stream_kind {
+    NDN_STREAM_HEAD,            /**< name and signature have arrived */
+    NDN_STREAM_DATA,            /**< the next piece of the content */
+    NDN_STREAM_END,             /**< all of the content has gone by */
+    NDN_STREAM_ABORTED          /**< the rest of the content is lost */
+};
+
+/**
+ * Describes a ContentObject whose content is being streamed.
+ */
+struct ndn_stream_info {
+    struct ndn *h;
+    const unsigned char *content_ndnb; /**< the object, with empty Content */
+    const struct ndn_parsed_ContentObject *pco; /**< its parse */
+    const struct ndn_indexbuf *content_comps; /**< its name components */
+    size_t content_size;        /**< bytes of content in all */
+    size_t offset;              /**< where data falls in the content */
+    const unsigned char *data;  /**< for NDN_STREAM_DATA */
+    size_t size;
+    int verified;               /**< for NDN_STREAM_END: 1 if the signature
+                                     is good, 0 if bad, -1 if not checked */
+};
+
+/**
+ * Receives the content of large ContentObjects as it is read.
+ *
+ * NDN_STREAM_HEAD comes first; returning -1 then declines the object,
+ * which is then buffered and delivered as usual.  Otherwise the content
+ * follows in order in NDN_STREAM_DATA calls, and then NDN_STREAM_END,
+ * after which the object, with its content left out, goes through the
+ * usual interest matching and upcalls.  Returning -1 from
+ * NDN_STREAM_DATA drops the rest, and the object ends with
+ * NDN_STREAM_ABORTED and no upcall.
+ *
+ * Note that the content is handed over before its signature has been
+ * checked, and before it is known to match any interest.  A sink whose
+ * output must be trusted holds the content until NDN_STREAM_END reports
+ * verified == 1, and drops it otherwise.
+ * @param data is the client data passed to ndn_set_content_sink().
+ * @returns 0 to continue, or -1 as described above.
+ */
+typedef int (*ndn_content_sink)(enum ndn_stream_kind kind,
+                                const struct ndn_stream_info *info,
+                                void *data);
+
+int ndn_set_content_sink(struct ndn *h, size_t min_size,
+                         ndn_content_sink sink, void *data);
+
+/*
+ * Writes each piece as it arrives, so what it writes may turn out to be
+ * forged; not for output that must be trusted.
+ */
+int ndn_content_sink_fd(enum ndn_stream_kind kind,
+                        const struct ndn_stream_info *info, void *data);
+
+#endif
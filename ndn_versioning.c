@@ -32,6 +32,9 @@
 #include <ndn/ndn_private.h>
 #include <sys/time.h>
 
+#include "ndn_arena.h"
+#include "ndn_coding.h"
+
 #define FF 0xff
 
 /**
@@ -65,7 +68,7 @@ answer_passive(struct ndn_charbuf *templ)
 static void
 answer_highest(struct ndn_charbuf *templ)
 {
-    ndnb_tagged_putf(templ, NDN_DTAG_ChildSelector, "1");
+    ndnb_append_tagged_number(templ, NDN_DTAG_ChildSelector, 1);
 }
 
 static void
@@ -105,11 +108,11 @@ resolve_templ(struct ndn_charbuf *templ, unsigned const char *vcomp,
     answer_highest(templ);
     answer_passive(templ);
     if ((versioning_flags & NDN_V_SCOPE2) != 0)
-        ndnb_tagged_putf(templ, NDN_DTAG_Scope, "%d", 2);
+        ndnb_append_tagged_number(templ, NDN_DTAG_Scope, 2);
     else if ((versioning_flags & NDN_V_SCOPE1) != 0)
-        ndnb_tagged_putf(templ, NDN_DTAG_Scope, "%d", 1);
+        ndnb_append_tagged_number(templ, NDN_DTAG_Scope, 1);
     else if ((versioning_flags & NDN_V_SCOPE0) != 0)
-        ndnb_tagged_putf(templ, NDN_DTAG_Scope, "%d", 0);
+        ndnb_append_tagged_number(templ, NDN_DTAG_Scope, 0);
     if (lifetime > 0)
         ndnb_append_tagged_binary_number(templ, NDN_DTAG_InterestLifetime, lifetime);
     ndn_charbuf_append_closer(templ); /* </Interest> */
@@ -272,12 +275,18 @@ ndn_create_version(struct ndn *h, struct ndn_charbuf *name,
     size_t oc = 0;
     int n;
     struct ndn_indexbuf *nix = NULL;
+    struct ndn_arena *arena = NULL;
+    unsigned char scratch[512]; /* room for nix to index 32 components */
     int myres = -1;
     int already_versioned = 0;
     int ok_flags = (NDN_V_REPLACE | NDN_V_HIGH | NDN_V_NOW | NDN_V_NESTOK);
     // XXX - right now we ignore h, but in the future we may use it to try to avoid non-monotonicies in the versions.
 
-    nix = ndn_indexbuf_create();
+    arena = ndn_arena_init(scratch, sizeof(scratch));
+    ndn_arena_enter(arena);
+    nix = ndn_arena_indexbuf(arena, 32);
+    if (nix == NULL)
+        goto Finish;
     n = ndn_name_split(name, nix);
     if (n < 0)
         goto Finish;
@@ -327,5 +336,6 @@ CloseName:
 Finish:
     myres = (myres < 0) ? -1 : 0;
     ndn_indexbuf_destroy(&nix);
+    ndn_arena_leave(arena);
     return(myres);
 }